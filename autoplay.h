@@ -0,0 +1,118 @@
+#ifndef AUTOPLAY_H
+#define AUTOPLAY_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "snakeCore.h"
+#include "terminalRenderer.h"
+
+// Headless, deterministic workload: bots play fixed-seed games on the boards
+// people actually use, and every phase is rendered into a discarded stream,
+// so the run goes through the same rules, bot and drawing code as a real
+// session. It drives the profile-guided build (see CMakeLists.txt) and
+// doubles as a benchmark: the same build always does the same work.
+
+struct AutoplayScenario {
+    const char* name;
+    int width, height;
+    int fruits, obstacles;       // 0 = the game's random defaults
+    bool enableObstacles, wrapAround;
+    LevelStyle level;
+    int snakes;                  // all bots
+    int games;                   // seeds 1..games
+    int maxPhases;               // per game, so a bot that never dies still ends
+    int fruitLifetime = 0;
+    bool powerUps = false;
+    int hazards = 0;
+    int portals = 0;
+};
+
+const AutoplayScenario AUTOPLAY_SCENARIOS[] = {
+    { "classic",         60,   30,    0,     0, true,  false, LEVEL_SCATTER, 8, 20, 20000 },
+    { "no obstacles",    60,   30,    0,     0, false, false, LEVEL_SCATTER, 8, 20, 20000 },
+    { "wrap",            60,   30,    0,     0, false, true,  LEVEL_SCATTER, 8, 20, 20000 },
+    { "solo",            60,   30,    0,     0, true,  false, LEVEL_SCATTER, 1, 20, 20000 },
+    { "walls",           60,   30,    0,     0, true,  false, LEVEL_WALLS,   4, 20, 20000 },
+    { "rooms",           60,   30,    0,     0, true,  true,  LEVEL_ROOMS,   4, 10,  5000 },
+    { "maze",            60,   30,    0,     0, true,  false, LEVEL_MAZE,    4, 10,  5000 },
+    { "power-ups",       60,   30,    0,     0, true,  false, LEVEL_SCATTER, 8, 20, 20000, 40, true },
+    { "hazards",         60,   30,    0,     0, true,  false, LEVEL_SCATTER, 4, 20, 20000, 0, false, 12 },
+    { "portals",         60,   30,    0,     0, true,  true,  LEVEL_SCATTER, 8, 20, 20000, 0, false, 0, 4 },
+    { "large",          400,  200,  300,  2000, true,  false, LEVEL_SCATTER, 8,  4, 20000, 0, false, 400 },
+    { "huge",          4000, 4000, 2000, 20000, true,  true,  LEVEL_SCATTER, 4,  1, 20000 },
+};
+
+// Swallows what the renderer writes
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+struct AutoplayResult {
+    long long games, phases, frames;
+    uint64_t checksum;           // fingerprints of every final state; equal runs give equal sums
+    double seconds;
+};
+
+inline AutoplayResult runAutoplay(bool verbose) {
+    AutoplayResult result = { 0, 0, 0, 0, 0 };
+    NullBuffer sink;
+    std::streambuf* saved = std::cout.rdbuf(&sink);
+    TerminalRenderer renderer;
+    std::vector<std::string> names;
+    auto start = std::chrono::steady_clock::now();
+
+    for (const AutoplayScenario& sc : AUTOPLAY_SCENARIOS) {
+        GameSettings settings;
+        settings.width = sc.width;
+        settings.height = sc.height;
+        settings.fruits = sc.fruits;
+        settings.obstacles = sc.obstacles;
+        settings.enableObstacles = sc.enableObstacles;
+        settings.wrapAround = sc.wrapAround;
+        settings.level = sc.level;
+        settings.fruitLifetime = sc.fruitLifetime;
+        settings.powerUps = sc.powerUps;
+        settings.hazards = sc.hazards;
+        settings.portals = sc.portals;
+        settings.snakes = sc.snakes;
+        settings.humans = 0;
+        names.clear();
+        for (int i = 0; i < sc.snakes; i++) names.push_back("Bot " + std::to_string(i + 1));
+
+        GameCore core(settings);
+        long long phases = 0;
+        for (int seed = 1; seed <= sc.games; seed++) {
+            core.reset(seed);
+            core.start();
+            renderer.requestFullRedraw();
+            for (int p = 0; p < sc.maxPhases && !core.isOver(); p++) {
+                core.stepPhase();
+                PanelInfo info;
+                info.started = true;
+                info.elapsedSeconds = core.getClock() / 1000000;
+                info.maxScore = 0;
+                info.focus = -1;
+                renderer.draw(core, names, info);
+                phases++;
+            }
+            result.checksum += core.fingerprint();
+            result.games++;
+        }
+        result.phases += phases;
+        if (verbose) fprintf(stderr, "autoplay: %-12s %3d games %8lld phases\n", sc.name, sc.games, phases);
+    }
+
+    result.frames = renderer.getStats().frames;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout.rdbuf(saved);
+    return result;
+}
+
+#endif
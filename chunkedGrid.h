@@ -0,0 +1,146 @@
+#ifndef CHUNKED_GRID_H
+#define CHUNKED_GRID_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// What can occupy a board cell. Each layer is a separate bitmap so a cell can be
+// tested for one kind of content with a single bit test. HAZARD marks the cells
+// of moving hazards and PORTAL both ends of every portal. CLAIM and CONTEST are
+// scratch layers used while all snakes move together in one phase.
+enum CellLayer { OBSTACLE_LAYER = 0, BODY_LAYER, FRUIT_LAYER, HAZARD_LAYER, PORTAL_LAYER, CLAIM_LAYER, CONTEST_LAYER, LAYER_COUNT };
+
+// Sparse board occupancy for boards up to tens of thousands of cells a side.
+// The board is cut into 64x64 chunks that are only allocated the first time a
+// cell inside them is set, so memory follows the touched area rather than
+// width*height. Each chunk keeps one 64-bit row mask per layer; a lookup is a
+// directory load plus a bit test, and untouched chunks read as empty.
+class ChunkedGrid {
+public:
+    static const int CHUNK_SHIFT = 6;
+    static const int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+    static const int CHUNK_MASK = CHUNK_SIZE - 1;
+
+    ChunkedGrid() : width(0), height(0), chunksX(0), chunksY(0), allocated(0) {}
+
+    // Drops all chunks and sizes the directory for a width x height board
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        chunksX = (w + CHUNK_MASK) >> CHUNK_SHIFT;
+        chunksY = (h + CHUNK_MASK) >> CHUNK_SHIFT;
+        chunks.clear();
+        chunks.resize((size_t)chunksX * chunksY);
+        allocated = 0;
+    }
+
+    void clear() { resize(width, height); }
+
+    bool test(int layer, int x, int y) const {
+        const Chunk* c = chunks[chunkIndex(x, y)].get();
+        if (!c) return false;
+        return (c->rows[layer][y & CHUNK_MASK] >> (x & CHUNK_MASK)) & 1;
+    }
+
+    void set(int layer, int x, int y) {
+        Chunk* c = touch(x, y);
+        c->rows[layer][y & CHUNK_MASK] |= uint64_t(1) << (x & CHUNK_MASK);
+    }
+
+    // Sets the cells of one 64-cell row segment at once: bit i of bits is cell
+    // (word * 64 + i, y). Chunks are 64 cells wide, so the word lands in one
+    // chunk row as it is, and an empty word allocates nothing.
+    void setBits(int layer, int y, int word, uint64_t bits) {
+        if (!bits) return;
+        Chunk* c = touch(word << CHUNK_SHIFT, y);
+        c->rows[layer][y & CHUNK_MASK] |= bits;
+    }
+
+    // Resetting never allocates: a missing chunk is already empty
+    void reset(int layer, int x, int y) {
+        Chunk* c = chunks[chunkIndex(x, y)].get();
+        if (!c) return;
+        c->rows[layer][y & CHUNK_MASK] &= ~(uint64_t(1) << (x & CHUNK_MASK));
+    }
+
+    // True if the cell is set in any of the layers selected by layerMask (bit per layer)
+    bool any(unsigned layerMask, int x, int y) const {
+        const Chunk* c = chunks[chunkIndex(x, y)].get();
+        if (!c) return false;
+        uint64_t bit = uint64_t(1) << (x & CHUNK_MASK);
+        int row = y & CHUNK_MASK;
+        for (int layer = 0; layer < LAYER_COUNT; layer++) {
+            if ((layerMask >> layer & 1) && (c->rows[layer][row] & bit)) return true;
+        }
+        return false;
+    }
+
+    // Calls fn(x, y) for every set cell of a layer, walking only allocated chunks
+    template <class Fn>
+    void forEach(int layer, Fn fn) const {
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const Chunk* c = chunks[i].get();
+            if (!c) continue;
+            int baseX = (int)(i % chunksX) << CHUNK_SHIFT;
+            int baseY = (int)(i / chunksX) << CHUNK_SHIFT;
+            for (int row = 0; row < CHUNK_SIZE; row++) {
+                uint64_t bits = c->rows[layer][row];
+                while (bits) {
+                    int bit = __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    fn(baseX + bit, baseY + row);
+                }
+            }
+        }
+    }
+
+    // Set cells of a layer, a popcount per chunk row on the board
+    size_t count(int layer) const {
+        size_t n = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const Chunk* c = chunks[i].get();
+            if (!c) continue;
+            int rows = height - (int)(i / chunksX) * CHUNK_SIZE;
+            if (rows > CHUNK_SIZE) rows = CHUNK_SIZE;
+            for (int row = 0; row < rows; row++) {
+                if (uint64_t bits = c->rows[layer][row]) n += __builtin_popcountll(bits);
+            }
+        }
+        return n;
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    size_t allocatedChunks() const { return allocated; }
+    size_t memoryBytes() const { return allocated * sizeof(Chunk) + chunks.size() * sizeof(chunks[0]); }
+
+private:
+    struct Chunk {
+        uint64_t rows[LAYER_COUNT][CHUNK_SIZE];
+        Chunk() { memset(rows, 0, sizeof(rows)); }
+    };
+
+    int width, height;
+    int chunksX, chunksY;
+    size_t allocated;
+    std::vector<std::unique_ptr<Chunk>> chunks; // chunksX * chunksY directory, null until touched
+
+    size_t chunkIndex(int x, int y) const {
+        return (size_t)(y >> CHUNK_SHIFT) * chunksX + (x >> CHUNK_SHIFT);
+    }
+
+    Chunk* touch(int x, int y) {
+        std::unique_ptr<Chunk>& slot = chunks[chunkIndex(x, y)];
+        if (!slot) {
+            slot.reset(new Chunk());
+            allocated++;
+        }
+        return slot.get();
+    }
+};
+
+inline unsigned layerBit(CellLayer layer) { return 1u << layer; }
+
+#endif
@@ -0,0 +1,49 @@
+# Profile-guided build, run with cmake -P (see the pgo target in CMakeLists.txt):
+#   1. configure BUILD_DIR with SNAKE_PGO=GENERATE and build
+#   2. train: theSnakeGame --autoplay, the fixed-seed workload in autoplay.h
+#   3. reconfigure the same tree with SNAKE_PGO=USE and rebuild with LTO
+# The workload ships with the sources, so the same sources and compiler give
+# the same profile and the same optimised binary.
+
+foreach(var SOURCE_DIR BUILD_DIR CXX GENERATOR)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "pgo.cmake needs -D${var}=...")
+    endif()
+endforeach()
+
+set(profileDir ${BUILD_DIR}/profile)
+
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "pgo: failed (${result}): ${ARGN}")
+    endif()
+endfunction()
+
+function(configure stage)
+    run(${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${BUILD_DIR} -G ${GENERATOR}
+        -DCMAKE_BUILD_TYPE=Release -DCMAKE_CXX_COMPILER=${CXX}
+        -DSNAKE_PGO=${stage} -DSNAKE_PGO_DIR=${profileDir})
+endfunction()
+
+# Stale profiles from older sources would only produce mismatch warnings
+file(REMOVE_RECURSE ${profileDir})
+file(MAKE_DIRECTORY ${profileDir})
+
+message(STATUS "pgo: instrumented build")
+configure(GENERATE)
+run(${CMAKE_COMMAND} --build ${BUILD_DIR} --target theSnakeGame)
+
+message(STATUS "pgo: training run")
+run(${CMAKE_COMMAND} -E env LLVM_PROFILE_FILE=${profileDir}/%p.profraw ${BUILD_DIR}/theSnakeGame --autoplay)
+
+file(GLOB rawProfiles ${profileDir}/*.profraw)
+if(rawProfiles)
+    find_program(LLVM_PROFDATA NAMES llvm-profdata REQUIRED)
+    run(${LLVM_PROFDATA} merge -output=${profileDir}/snake.profdata ${rawProfiles})
+endif()
+
+message(STATUS "pgo: optimised build")
+configure(USE)
+run(${CMAKE_COMMAND} --build ${BUILD_DIR})
+run(${BUILD_DIR}/theSnakeGame --autoplay)
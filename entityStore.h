@@ -0,0 +1,98 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Entity-component storage for board items that carry state of their own.
+// An entity is just a number. Each component type lives in a sparse set: a
+// dense array of values with their entities alongside, and a sparse table
+// from entity to slot. Adding, finding and removing are O(1), and a system
+// that needs one component walks one contiguous array, however many kinds of
+// entity there are. Removing moves the last value into the hole, so dense
+// order is only stable while nothing is removed.
+
+typedef uint32_t Entity;
+
+template <class T>
+class Components {
+public:
+    bool has(Entity e) const { return e < sparse.size() && sparse[e] != NO_SLOT; }
+
+    T& get(Entity e) { return values[sparse[e]]; }
+    const T& get(Entity e) const { return values[sparse[e]]; }
+
+    // Adds e's value, or replaces it if e already has one
+    T& add(Entity e, const T& value) {
+        if (e >= sparse.size()) sparse.resize(e + 1, NO_SLOT);
+        if (sparse[e] != NO_SLOT) return values[sparse[e]] = value;
+        sparse[e] = values.size();
+        owners.push_back(e);
+        values.push_back(value);
+        return values.back();
+    }
+
+    bool remove(Entity e) {
+        if (!has(e)) return false;
+        uint32_t slot = sparse[e], last = values.size() - 1;
+        if (slot != last) {
+            values[slot] = values[last];
+            owners[slot] = owners[last];
+            sparse[owners[slot]] = slot;
+        }
+        values.pop_back();
+        owners.pop_back();
+        sparse[e] = NO_SLOT;
+        return true;
+    }
+
+    void clear() {
+        for (Entity e : owners) sparse[e] = NO_SLOT;
+        values.clear();
+        owners.clear();
+    }
+
+    // Dense access, for systems: value i belongs to owner(i)
+    size_t size() const { return values.size(); }
+    T& operator[](size_t i) { return values[i]; }
+    const T& operator[](size_t i) const { return values[i]; }
+    Entity owner(size_t i) const { return owners[i]; }
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    std::vector<uint32_t> sparse; // entity -> slot
+    std::vector<Entity> owners;   // slot -> entity
+    std::vector<T> values;
+};
+
+// Hands out entity numbers, reusing freed ones most recent first so the
+// sparse tables stay as small as the most entities alive at once. The same
+// calls in the same order give the same numbers.
+class EntityPool {
+public:
+    EntityPool() : next(0) {}
+
+    Entity create() {
+        if (freed.empty()) return next++;
+        Entity e = freed.back();
+        freed.pop_back();
+        return e;
+    }
+
+    // The caller removes e's components
+    void destroy(Entity e) { freed.push_back(e); }
+
+    void clear() {
+        next = 0;
+        freed.clear();
+    }
+
+    size_t alive() const { return next - freed.size(); }
+
+private:
+    Entity next;
+    std::vector<Entity> freed;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <termios.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include "tracer.h"
+
+// Single epoll reactor for the game: waits on stdin, a timerfd that drives the
+// game ticks and a signalfd for SIGWINCH/SIGINT/SIGTERM. The process sleeps in
+// epoll_wait() whenever nothing is due, so idle screens cost no CPU.
+
+// Tick timing as the loop sees it. A tick that fires a whole period late has
+// cost the game a step of real time, so it counts as dropped.
+struct TickStats {
+    uint64_t ticks;
+    uint64_t dropped;
+    long long lastLateNanos; // how late the most recent tick fired
+};
+
+class EventLoop {
+public:
+    enum Event { KEY, TICK, RESIZE, QUIT, SOCKET };
+
+    EventLoop() : armed(false), deadline(0), period(0), socketFd(-1), keyPos(0), keyLen(0), ticks(0), tickStats(), resized(false), quit(false), socketReady(false) {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGWINCH);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        sigprocmask(SIG_BLOCK, &mask, &oldMask);
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (epollFd < 0 || timerFd < 0 || signalFd < 0) {
+            perror("event loop");
+            exit(1);
+        }
+        watch(STDIN_FILENO);
+        watch(timerFd);
+        watch(signalFd);
+
+        // Raw-ish terminal for the whole session instead of toggling per key
+        tcgetattr(STDIN_FILENO, &oldTermios);
+        struct termios raw = oldTermios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+
+    ~EventLoop() {
+        tcsetattr(STDIN_FILENO, TCSANOW, &oldTermios);
+        std::cout << "\033[0m" << std::flush;
+        close(signalFd);
+        close(timerFd);
+        close(epollFd);
+        sigprocmask(SIG_SETMASK, &oldMask, nullptr);
+    }
+
+    // Fires one TICK after delayUs; 0 disarms. Any expiry still pending from
+    // the previous arming is dropped, since it belonged to the old schedule.
+    void armTimer(long long delayUs) {
+        struct itimerspec spec = {};
+        spec.it_value.tv_sec = delayUs / 1000000;
+        spec.it_value.tv_nsec = (delayUs % 1000000) * 1000L;
+        timerfd_settime(timerFd, 0, &spec, nullptr);
+        armed = delayUs > 0;
+        ticks = 0;
+        period = delayUs * 1000;
+        deadline = nowNanos() + period;
+    }
+
+    const TickStats& getTickStats() const { return tickStats; }
+
+    // Also wake up when fd (a network connection) becomes readable. Level
+    // triggered: the caller reads what it needs after each SOCKET event.
+    void watchSocket(int fd) {
+        socketFd = fd;
+        watch(fd);
+    }
+
+    // Drops keys typed before this point (e.g. while the snake was crashing)
+    void flushInput() {
+        keyPos = keyLen = 0;
+        tcflush(STDIN_FILENO, TCIFLUSH);
+    }
+
+    // Blocks until something happens. Pending events are handed out in the
+    // order quit, resize, keys, socket, tick so input always lands before a move.
+    Event next(char& key) {
+        while (true) {
+            if (quit) return QUIT;
+            if (resized) {
+                resized = false;
+                return RESIZE;
+            }
+            if (keyPos < keyLen) {
+                key = keyBuf[keyPos++];
+                return KEY;
+            }
+            if (socketReady) {
+                socketReady = false;
+                return SOCKET;
+            }
+            if (ticks > 0) {
+                ticks = 0;
+                armed = false;
+                return TICK;
+            }
+
+            struct epoll_event events[4];
+            int n;
+            {
+                TRACE_SPAN("sleep");
+                n = epoll_wait(epollFd, events, 4, -1);
+            }
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return QUIT;
+            }
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == signalFd) {
+                    struct signalfd_siginfo info;
+                    while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+                        if (info.ssi_signo == SIGWINCH) resized = true;
+                        else quit = true;
+                    }
+                } else if (fd == timerFd) {
+                    uint64_t expirations;
+                    if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations) && armed) {
+                        ticks += expirations;
+                        tickStats.ticks++;
+                        tickStats.lastLateNanos = nowNanos() - deadline;
+                        if (tickStats.lastLateNanos >= period) tickStats.dropped++;
+                    }
+                } else if (fd == socketFd) {
+                    socketReady = true;
+                } else if (fd == STDIN_FILENO) {
+                    ssize_t got = read(STDIN_FILENO, keyBuf, sizeof(keyBuf));
+                    if (got <= 0) quit = true; // stdin closed
+                    else {
+                        keyPos = 0;
+                        keyLen = got;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    int epollFd, timerFd, signalFd;
+    bool armed;
+    long long deadline, period; // nanoseconds: when the armed tick is due, and its delay
+    int socketFd;
+    char keyBuf[64];
+    int keyPos, keyLen;
+    uint64_t ticks;
+    TickStats tickStats;
+    bool resized, quit, socketReady;
+    sigset_t oldMask;
+    struct termios oldTermios;
+
+    static long long nowNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void watch(int fd) {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl");
+            exit(1);
+        }
+    }
+};
+
+#endif
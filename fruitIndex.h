@@ -0,0 +1,168 @@
+#ifndef FRUIT_INDEX_H
+#define FRUIT_INDEX_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+// Red and green fruit change the snake's speed for good; the power-ups
+// grant a timed effect instead
+enum FruitType { NORMAL, SLOW, GHOST_FRUIT, DOUBLE_FRUIT, SLOWMO_FRUIT, FRUIT_TYPE_COUNT };
+
+struct Fruit {
+    int x, y;
+    FruitType type;
+    long long expiresAt = 0; // game clock it vanishes at; 0 = never
+};
+
+// Fruits bucketed on a uniform grid. The bucket side is a power of two picked
+// so that a bucket holds a handful of fruits on average, which keeps hit tests
+// O(1) and lets nearest-fruit queries stop after a few rings of buckets.
+// Fruits are stored densely (iteration is a plain array walk); each one is
+// also linked into its bucket so erase is O(1) via swap-with-last.
+class FruitIndex {
+public:
+    FruitIndex() : width(0), height(0), shift(2), bucketsX(0), bucketsY(0) {}
+
+    // Empties the index and sizes the buckets for about expectedFruits fruits
+    void reset(int w, int h, int expectedFruits) {
+        width = w;
+        height = h;
+        // Grow the bucket side until there are about as many buckets as fruits
+        long long target = 2LL * std::max(1, expectedFruits) + 16;
+        shift = 2;
+        while (shift < 16 && (long long)((w - 1) >> shift) * ((h - 1) >> shift) > target) shift++;
+        bucketsX = ((w - 1) >> shift) + 1;
+        bucketsY = ((h - 1) >> shift) + 1;
+        heads.assign((size_t)bucketsX * bucketsY, -1);
+        entries.clear();
+    }
+
+    void insert(const Fruit& fruit) {
+        int b = bucketOf(fruit.x, fruit.y);
+        Entry e;
+        e.fruit = fruit;
+        e.prev = -1;
+        e.next = heads[b];
+        int i = entries.size();
+        if (e.next >= 0) entries[e.next].prev = i;
+        heads[b] = i;
+        entries.push_back(e);
+    }
+
+    const Fruit* find(int x, int y) const {
+        for (int i = heads[bucketOf(x, y)]; i >= 0; i = entries[i].next) {
+            if (entries[i].fruit.x == x && entries[i].fruit.y == y) return &entries[i].fruit;
+        }
+        return nullptr;
+    }
+
+    bool erase(int x, int y) {
+        int b = bucketOf(x, y);
+        int i = heads[b];
+        while (i >= 0 && !(entries[i].fruit.x == x && entries[i].fruit.y == y)) i = entries[i].next;
+        if (i < 0) return false;
+        unlink(i, b);
+
+        // Move the last entry into the hole and repoint its neighbours
+        int last = entries.size() - 1;
+        if (i != last) {
+            entries[i] = entries[last];
+            Entry& moved = entries[i];
+            if (moved.prev >= 0) entries[moved.prev].next = i;
+            else heads[bucketOf(moved.fruit.x, moved.fruit.y)] = i;
+            if (moved.next >= 0) entries[moved.next].prev = i;
+        }
+        entries.pop_back();
+        return true;
+    }
+
+    // Up to k fruits closest to (x, y) by Manhattan distance, nearest first.
+    // Buckets are visited in rings around the query; the search stops once no
+    // unvisited ring can beat the k-th candidate. With wrap the board is a
+    // torus: rings continue across the edges and distances take the short way
+    // round. Ties go to the lower (y, x), so the answer doesn't depend on the
+    // order fruits were inserted in. Does not allocate.
+    int nearest(int x, int y, int k, Fruit* out, bool wrap = false) const {
+        if (k <= 0 || entries.empty()) return 0;
+        const int MAX_K = 16;
+        k = std::min(k, MAX_K);
+        long long bestKey[MAX_K]; // distance, then y, then x
+        int bestIdx[MAX_K];
+        int found = 0;
+
+        int bx = x >> shift, by = y >> shift;
+        int side = 1 << shift;
+        int maxRing = wrap ? std::max(bucketsX, bucketsY) / 2 + 1
+                           : std::max(std::max(bx, bucketsX - 1 - bx), std::max(by, bucketsY - 1 - by));
+        for (int r = 0; r <= maxRing; r++) {
+            for (int ry = by - r; ry <= by + r; ry++) {
+                int cy = wrap ? (ry % bucketsY + bucketsY) % bucketsY : ry;
+                if (cy < 0 || cy >= bucketsY) continue;
+                // Only the ring's perimeter: full rows at the top and bottom, two cells otherwise
+                int step = (ry == by - r || ry == by + r) ? 1 : 2 * r;
+                for (int rx = bx - r; rx <= bx + r; rx += step) {
+                    int cx = wrap ? (rx % bucketsX + bucketsX) % bucketsX : rx;
+                    if (cx < 0 || cx >= bucketsX) continue;
+                    for (int i = heads[(size_t)cy * bucketsX + cx]; i >= 0; i = entries[i].next) {
+                        const Fruit& f = entries[i].fruit;
+                        int dx = abs(f.x - x), dy = abs(f.y - y);
+                        if (wrap) {
+                            dx = std::min(dx, width - dx);
+                            dy = std::min(dy, height - dy);
+                        }
+                        long long key = (long long)(dx + dy) << 34 | (long long)f.y << 17 | f.x;
+                        if (found == k && key >= bestKey[k - 1]) continue;
+                        // Small boards let wrapped rings revisit a bucket
+                        bool seen = false;
+                        for (int j = 0; wrap && j < found; j++) seen |= bestIdx[j] == i;
+                        if (seen) continue;
+                        int pos = found < k ? found++ : k - 1;
+                        while (pos > 0 && bestKey[pos - 1] > key) {
+                            bestKey[pos] = bestKey[pos - 1];
+                            bestIdx[pos] = bestIdx[pos - 1];
+                            pos--;
+                        }
+                        bestKey[pos] = key;
+                        bestIdx[pos] = i;
+                    }
+                }
+            }
+            // Anything in ring r+1 is at least r*side+1 cells away; across the
+            // seam the last, partial bucket can be up to one side closer
+            int bound = wrap ? (r - 1) * side : r * side;
+            if (found == k && (bestKey[k - 1] >> 34) <= bound) break;
+        }
+        for (int i = 0; i < found; i++) out[i] = entries[bestIdx[i]].fruit;
+        return found;
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    const Fruit& operator[](size_t i) const { return entries[i].fruit; }
+
+private:
+    struct Entry {
+        Fruit fruit;
+        int prev, next; // neighbours in the same bucket, -1 at the ends
+    };
+
+    int width, height;
+    int shift; // log2 of the bucket side
+    int bucketsX, bucketsY;
+    std::vector<int> heads; // first entry per bucket, -1 if empty
+    std::vector<Entry> entries;
+
+    int bucketOf(int x, int y) const {
+        return (y >> shift) * bucketsX + (x >> shift);
+    }
+
+    void unlink(int i, int b) {
+        Entry& e = entries[i];
+        if (e.prev >= 0) entries[e.prev].next = e.next;
+        else heads[b] = e.next;
+        if (e.next >= 0) entries[e.next].prev = e.prev;
+    }
+};
+
+#endif
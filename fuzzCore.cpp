@@ -0,0 +1,268 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gameSave.h"
+#include "snakeCore.h"
+
+using namespace std;
+
+// Drives the headless game core with arbitrary inputs and checks its
+// invariants after every phase, scanning the whole board every
+// FULL_CHECK_PHASES of them. Built with SNAKE_FUZZ (see CMakeLists.txt)
+// it is a libFuzzer target; otherwise main() below runs seeded random
+// inputs, or replays the files it is given.
+//
+// An input is a 14-byte header, then one byte per action; missing bytes
+// read as zero.
+//   0-7   game seed
+//   8     width, 5 + b % 60
+//   9     height, 2 + b % 40
+//   10    snakes 1 + b % 8 (fewer than the rows), humans (b >> 4) % (snakes + 1)
+//   11    bit 0 wrap, bit 1 obstacles, bit 2 power-ups, bits 3-4 level style,
+//         bits 5-7 fruit lifetime in steps of 8 effect ticks
+//   12    fruits b % 16 (0 = random), obstacles 4 * (b >> 4) (0 = default)
+//   13    hazards b % 16, portals b >> 4 (pairs, up to 15)
+// An action byte steers a human (bits 0-1 the direction, bits 2-4 the
+// snake, modulo the humans) and then plays 2^p - 1 phases, p being bits 5-7.
+// With no phases and snake bits 7 it round-trips the game through a save
+// instead.
+
+const size_t FUZZ_HEADER = 14;
+const int FULL_CHECK_PHASES = 64; // phases between whole-board scans; each input also ends with one
+
+struct FuzzState {
+    GameCore core;
+    vector<uint32_t> stamps; // per cell: the check that last saw a body there
+    uint32_t stamp = 0;
+    GameCore copy;           // save round trips land here
+    string save;
+    long long steps = 0;     // snake steps played, for the rate
+};
+
+const uint8_t* currentInput = nullptr;
+size_t currentSize = 0;
+
+// Where main() writes the input that broke an invariant; libFuzzer keeps its own
+const char* crashPath = nullptr;
+
+[[noreturn]] void fail(const char* what) {
+    fprintf(stderr, "fuzzCore: %s\n", what);
+    if (crashPath) {
+        FILE* f = fopen(crashPath, "wb");
+        if (f) {
+            fwrite(currentInput, 1, currentSize, f);
+            fclose(f);
+            fprintf(stderr, "fuzzCore: input written to %s\n", crashPath);
+        }
+    }
+    abort();
+}
+
+uint8_t inputByte(size_t i) { return i < currentSize ? currentInput[i] : 0; }
+
+GameSettings decodeSettings(uint64_t& seed) {
+    seed = 0;
+    for (int i = 0; i < 8; i++) seed |= (uint64_t)inputByte(i) << (8 * i);
+    GameSettings s;
+    s.width = 5 + inputByte(8) % 60;
+    s.height = 2 + inputByte(9) % 40;
+    s.snakes = min(1 + inputByte(10) % 8, s.height - 1);
+    s.humans = (inputByte(10) >> 4) % (s.snakes + 1);
+    uint8_t flags = inputByte(11);
+    s.wrapAround = flags & 1;
+    s.enableObstacles = flags & 2;
+    s.powerUps = flags & 4;
+    s.level = (LevelStyle)((flags >> 3) & 3);
+    s.fruitLifetime = 8 * (flags >> 5);
+    s.fruits = inputByte(12) % 16;
+    s.obstacles = 4 * (inputByte(12) >> 4);
+    s.hazards = inputByte(13) % 16;
+    s.portals = inputByte(13) >> 4;
+    return s;
+}
+
+// A live snake is as long as what it ate makes it and its score adds up;
+// fruits sit on nothing solid; hazards never share a cell with a body. Only
+// heads are checked against the grid every phase: the full scan (full) adds
+// that bodies are unique and mirrored in the grid cell for cell, and that the
+// grid holds nothing the snakes, fruits and hazards don't.
+void checkInvariants(const GameCore& core, FuzzState& st, bool full) {
+    const GameSettings& settings = core.getSettings();
+    const ChunkedGrid& grid = core.getGrid();
+    size_t cells = (size_t)settings.width * settings.height;
+    if (full && st.stamps.size() != cells) {
+        st.stamps.assign(cells, 0);
+        st.stamp = 0;
+    }
+    st.stamp += full;
+
+    size_t bodyCells = 0;
+    int maxPoints = settings.powerUps ? 2 * FRUIT_KINDS[NORMAL].points : FRUIT_KINDS[NORMAL].points;
+    for (const Snake& s : core.getSnakes()) {
+        if (!s.alive) {
+            if (!s.body.empty()) fail("a dead snake still has a body");
+            continue;
+        }
+        if (s.body.size() != 3 + (size_t)s.fruitsEaten) fail("a snake's length doesn't match the fruits it ate");
+        if (s.score % 5 || s.score < 5 * s.fruitsEaten || s.score > maxPoints * s.fruitsEaten) fail("a score doesn't add up to the fruits eaten");
+        if (s.speed < FASTEST_SPEED || s.speed > SLOWEST_SPEED) fail("a snake's speed is out of range");
+        const Cell& head = s.body.front();
+        if (head.x < 0 || head.x >= settings.width || head.y < 0 || head.y >= settings.height) fail("a head is off the board");
+        if (!core.isSnakeBody(head.x, head.y)) fail("a head is missing from the grid");
+        if (!full) continue;
+        for (const Cell& c : s.body) {
+            if (c.x < 0 || c.x >= settings.width || c.y < 0 || c.y >= settings.height) fail("a body cell is off the board");
+            uint32_t& seen = st.stamps[(size_t)c.y * settings.width + c.x];
+            if (seen == st.stamp) fail("two body cells share a cell");
+            seen = st.stamp;
+            if (!core.isSnakeBody(c.x, c.y)) fail("a body cell is missing from the grid");
+            bodyCells++;
+        }
+    }
+    if (full && grid.count(BODY_LAYER) != bodyCells) fail("the grid has body cells no snake has");
+
+    const FruitIndex& fruits = core.getFruits();
+    for (size_t i = 0; i < fruits.size(); i++) {
+        const Fruit& f = fruits[i];
+        if (f.x < 0 || f.x >= settings.width || f.y < 0 || f.y >= settings.height) fail("a fruit is off the board");
+        if (!core.isFruit(f.x, f.y)) fail("a fruit is missing from the grid");
+        if (grid.any(layerBit(BODY_LAYER) | layerBit(OBSTACLE_LAYER) | layerBit(PORTAL_LAYER), f.x, f.y)) {
+            fail("a fruit is under a snake, on an obstacle or on a portal");
+        }
+    }
+    if (full && grid.count(FRUIT_LAYER) != fruits.size()) fail("the grid has fruit cells the index doesn't");
+
+    const BoardEntities& entities = core.getEntities();
+    for (size_t i = 0; i < entities.motion.size(); i++) {
+        Cell c = entities.position.get(entities.motion.owner(i));
+        if (!core.isHazard(c.x, c.y)) fail("a hazard is missing from the grid");
+        if (core.isSnakeBody(c.x, c.y)) fail("a hazard shares a cell with a snake");
+    }
+    if (full && grid.count(HAZARD_LAYER) != entities.motion.size()) fail("two hazards share a cell");
+}
+
+// Plays one input; returns the phases it took
+long long runInput(const uint8_t* data, size_t size, FuzzState& st) {
+    currentInput = data;
+    currentSize = size;
+    uint64_t seed;
+    GameSettings settings = decodeSettings(seed);
+    // clearBoard() takes the settings without laying out a round, so only
+    // reset() builds a board
+    GameCore& core = st.core;
+    core.clearBoard(settings);
+    core.reset(seed);
+    core.start();
+    checkInvariants(core, st, true);
+
+    long long phases = 0;
+    for (size_t i = FUZZ_HEADER; i < size && !core.isOver(); i++) {
+        uint8_t action = data[i];
+        Direction d = (Direction)(UP + (action & 3));
+        int who = (action >> 2) & 7, steps = (1 << (action >> 5)) - 1;
+        if (steps == 0 && who == 7) {
+            encodeSave(core, SaveExtras(), st.save);
+            if (!decodeSave(st.save.data(), st.save.size(), st.copy)) fail("a save doesn't load");
+            if (st.copy.fingerprint() != core.fingerprint()) fail("a loaded save plays differently");
+            checkInvariants(st.copy, st, true);
+            continue;
+        }
+        if (settings.humans) {
+            int snake = who % settings.humans;
+            const Snake& s = core.getSnakes()[snake];
+            Direction before = s.dir;
+            core.steer(snake, d);
+            if (s.alive && s.dir != before) {
+                Cell next = core.nextHead(snake, s.dir), neck = s.body[1];
+                if (next.x == neck.x && next.y == neck.y) fail("a snake was steered back onto its neck");
+            }
+        }
+        for (int k = 0; k < steps; k++) {
+            long long due = core.nextMoveTime();
+            if (due < 0) break;
+            for (const Snake& s : core.getSnakes()) st.steps += s.alive && s.dir != STOP && s.nextMoveAt == due;
+            core.stepPhase();
+            phases++;
+            checkInvariants(core, st, phases % FULL_CHECK_PHASES == 0);
+        }
+    }
+    checkInvariants(core, st, true);
+    return phases;
+}
+
+#ifdef SNAKE_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static FuzzState st;
+    runInput(data, size, st);
+    return 0;
+}
+
+#else
+
+// Usage: fuzzCore [--runs N] [--seed N] [--max-length N] [FILE...]
+//        with files, replays each of them; otherwise plays N random inputs
+int main(int argc, char* argv[]) {
+    long long runs = 100000;
+    uint64_t seed = 1;
+    size_t maxLength = 512;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) {
+            runs = max(1LL, atoll(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--max-length" && i + 1 < argc) {
+            maxLength = max(FUZZ_HEADER + 1, (size_t)atoll(argv[++i]));
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            cerr << "Usage: " << argv[0] << " [--runs N] [--seed N] [--max-length N] [FILE...]" << endl;
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    FuzzState st;
+    long long phases = 0, inputs = 0;
+    auto start = chrono::steady_clock::now();
+    if (!files.empty()) {
+        for (const string& path : files) {
+            FILE* f = fopen(path.c_str(), "rb");
+            if (!f) {
+                perror(path.c_str());
+                return 1;
+            }
+            vector<uint8_t> data;
+            uint8_t buf[4096];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+            fclose(f);
+            phases += runInput(data.data(), data.size(), st);
+            inputs++;
+        }
+    } else {
+        crashPath = "fuzzCore-crash.bin";
+        GameRng rng = { seed };
+        vector<uint8_t> data;
+        for (; inputs < runs; inputs++) {
+            data.resize(FUZZ_HEADER + rng.below(maxLength - FUZZ_HEADER + 1));
+            for (size_t i = 0; i < data.size(); i += 8) {
+                uint64_t word = rng.next();
+                memcpy(&data[i], &word, min((size_t)8, data.size() - i));
+            }
+            phases += runInput(data.data(), data.size(), st);
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%lld inputs, %lld phases, %lld snake steps in %.2fs: %.0f steps/s, no invariant broken\n", inputs, phases, st.steps,
+           seconds, seconds > 0 ? st.steps / seconds : 0.0);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,353 @@
+#ifndef GAME_SAVE_H
+#define GAME_SAVE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snakeCore.h"
+
+// Whole-game snapshots in a fixed binary layout: a header, then the snakes,
+// every body cell, the fruits, the obstacles, the hazards and the portals as flat arrays
+// of fixed-size records, little-endian. Section sizes follow from the counts in the header,
+// so a save is read with one read() or mmap and checked by arithmetic, with
+// nothing to parse. The same bytes clone a game in memory (a GameCore can't
+// be copied) for bot look-ahead or to keep seek points in a replay.
+
+const uint32_t SAVE_MAGIC = 0x534e4b53; // "SNKS"
+const uint32_t SAVE_VERSION = 4;        // bump on any layout change; older saves are refused
+const int SAVE_NAME_SIZE = 32;
+
+struct SaveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;     // sizeof(SaveHeader) when written
+    uint32_t snakeCount;
+    int32_t width, height;
+    int32_t fruitsSetting, obstaclesSetting;
+    uint8_t enableObstacles, wrapAround, humans, started;
+    uint32_t cellCount;      // body cells of all snakes together
+    uint32_t fruitCount;
+    uint32_t obstacleCount;
+    int64_t clock;
+    uint64_t rng;
+    int64_t elapsedMicros;   // wall time played, for the panel's clock
+    int32_t maxScore;
+    uint32_t level;          // LevelStyle, for the next round
+    int32_t fruitLifetime;
+    uint8_t powerUps, pad[3];
+    int32_t hazardsSetting;
+    uint32_t hazardCount;
+    int64_t hazardTick;      // effect tick the hazards last moved on
+    int32_t portalsSetting;
+    uint32_t portalCount;    // portal cells, two per pair
+};
+
+struct SaveSnake {
+    char name[SAVE_NAME_SIZE];
+    int32_t dir, score, speed, fruitsEaten;
+    int64_t nextMoveAt;
+    uint8_t alive, bot, pad[2];
+    uint32_t bodyLength;     // cells in the body section, head first
+    int64_t effectEnds[EFFECT_COUNT];
+};
+
+struct SaveCell {
+    int32_t x, y;
+};
+
+struct SaveFruit {
+    int32_t x, y, type, pad;
+    int64_t expiresAt;
+};
+
+struct SaveHazard {
+    int32_t x, y;
+    int8_t dx, dy, heading, pad;
+    uint16_t patrolLength, patrolAt;
+};
+
+// A portal cell and where entering it comes out
+struct SavePortal {
+    int32_t x, y, exitX, exitY;
+};
+
+static_assert(sizeof(SaveHeader) == 112 && sizeof(SaveSnake) == 88 && sizeof(SaveCell) == 8 && sizeof(SaveFruit) == 24 &&
+              sizeof(SaveHazard) == 16 && sizeof(SavePortal) == 16,
+              "the save layout must not depend on the compiler");
+
+// What the front end keeps around a GameCore
+struct SaveExtras {
+    std::vector<std::string> names;
+    long long elapsedMicros = 0;
+    int maxScore = 0;
+};
+
+inline void encodeSave(const GameCore& core, const SaveExtras& extras, std::string& out) {
+    const GameSettings& settings = core.getSettings();
+    const std::vector<Snake>& snakes = core.getSnakes();
+    const FruitIndex& fruits = core.getFruits();
+    uint32_t cells = 0;
+    for (const Snake& s : snakes) cells += s.body.size();
+    const BoardEntities& entities = core.getEntities();
+    uint32_t obstacles = 0;
+    core.forEachObstacle([&obstacles](int, int) { obstacles++; });
+
+    out.assign(sizeof(SaveHeader) + snakes.size() * sizeof(SaveSnake) + cells * sizeof(SaveCell) +
+               fruits.size() * sizeof(SaveFruit) + obstacles * sizeof(SaveCell) + entities.motion.size() * sizeof(SaveHazard) +
+               entities.exit.size() * sizeof(SavePortal), '\0');
+    char* p = &out[0];
+
+    SaveHeader* h = (SaveHeader*)p;
+    h->magic = SAVE_MAGIC;
+    h->version = SAVE_VERSION;
+    h->headerSize = sizeof(SaveHeader);
+    h->snakeCount = snakes.size();
+    h->width = settings.width;
+    h->height = settings.height;
+    h->fruitsSetting = settings.fruits;
+    h->obstaclesSetting = settings.obstacles;
+    h->enableObstacles = settings.enableObstacles;
+    h->wrapAround = settings.wrapAround;
+    h->humans = settings.humans;
+    h->started = core.isStarted();
+    h->cellCount = cells;
+    h->fruitCount = fruits.size();
+    h->obstacleCount = obstacles;
+    h->clock = core.getClock();
+    h->rng = core.getRngState();
+    h->elapsedMicros = extras.elapsedMicros;
+    h->maxScore = extras.maxScore;
+    h->level = settings.level;
+    h->fruitLifetime = settings.fruitLifetime;
+    h->powerUps = settings.powerUps;
+    h->hazardsSetting = settings.hazards;
+    h->hazardCount = entities.motion.size();
+    h->hazardTick = entities.movedTick;
+    h->portalsSetting = settings.portals;
+    h->portalCount = entities.exit.size();
+    p += sizeof(SaveHeader);
+
+    SaveSnake* snakeOut = (SaveSnake*)p;
+    SaveCell* cellOut = (SaveCell*)(snakeOut + snakes.size());
+    for (size_t i = 0; i < snakes.size(); i++) {
+        const Snake& s = snakes[i];
+        SaveSnake& o = snakeOut[i];
+        if (i < extras.names.size()) memcpy(o.name, extras.names[i].data(), std::min(extras.names[i].size(), (size_t)SAVE_NAME_SIZE));
+        o.dir = s.dir;
+        o.score = s.score;
+        o.speed = s.speed;
+        o.fruitsEaten = s.fruitsEaten;
+        o.nextMoveAt = s.nextMoveAt;
+        o.alive = s.alive;
+        o.bot = s.bot;
+        o.bodyLength = s.body.size();
+        for (int e = 0; e < EFFECT_COUNT; e++) o.effectEnds[e] = s.effectEnds[e];
+        for (const Cell& c : s.body) {
+            cellOut->x = c.x;
+            cellOut->y = c.y;
+            cellOut++;
+        }
+    }
+    SaveFruit* fruitOut = (SaveFruit*)cellOut;
+    for (size_t i = 0; i < fruits.size(); i++) {
+        fruitOut[i].x = fruits[i].x;
+        fruitOut[i].y = fruits[i].y;
+        fruitOut[i].type = fruits[i].type;
+        fruitOut[i].expiresAt = fruits[i].expiresAt;
+    }
+    SaveCell* obstacleOut = (SaveCell*)(fruitOut + fruits.size());
+    core.forEachObstacle([&obstacleOut](int x, int y) {
+        obstacleOut->x = x;
+        obstacleOut->y = y;
+        obstacleOut++;
+    });
+    SaveHazard* hazardOut = (SaveHazard*)obstacleOut;
+    for (size_t i = 0; i < entities.motion.size(); i++) {
+        const Cell& c = entities.position.get(entities.motion.owner(i));
+        const Motion& m = entities.motion[i];
+        hazardOut[i].x = c.x;
+        hazardOut[i].y = c.y;
+        hazardOut[i].dx = m.dx;
+        hazardOut[i].dy = m.dy;
+        hazardOut[i].heading = m.heading;
+        hazardOut[i].patrolLength = m.patrolLength;
+        hazardOut[i].patrolAt = m.patrolAt;
+    }
+    SavePortal* portalOut = (SavePortal*)(hazardOut + entities.motion.size());
+    for (size_t i = 0; i < entities.exit.size(); i++) {
+        const Cell& c = entities.position.get(entities.exit.owner(i));
+        portalOut[i].x = c.x;
+        portalOut[i].y = c.y;
+        portalOut[i].exitX = entities.exit[i].x;
+        portalOut[i].exitY = entities.exit[i].y;
+    }
+}
+
+// Rebuilds the game from a save; false (and core untouched) if the bytes
+// are not a complete save of this version
+inline bool decodeSave(const char* data, size_t size, GameCore& core, SaveExtras* extras = nullptr) {
+    if (size < sizeof(SaveHeader)) return false;
+    SaveHeader h;
+    memcpy(&h, data, sizeof(h));
+    if (h.magic != SAVE_MAGIC || h.version != SAVE_VERSION || h.headerSize != sizeof(SaveHeader)) return false;
+    if (h.width < 5 || h.height < 1 || h.width > MAX_BOARD_SIDE || h.height > MAX_BOARD_SIDE) return false;
+    if (h.snakeCount < 1 || h.snakeCount > (uint32_t)MAX_SNAKES || h.humans > h.snakeCount || h.level >= LEVEL_STYLE_COUNT || h.fruitLifetime < 0 ||
+        h.hazardsSetting < 0 || h.hazardTick < 0 || h.portalsSetting < 0) return false;
+    uint64_t expected = sizeof(SaveHeader) + (uint64_t)h.snakeCount * sizeof(SaveSnake) + (uint64_t)h.cellCount * sizeof(SaveCell) +
+                        (uint64_t)h.fruitCount * sizeof(SaveFruit) + (uint64_t)h.obstacleCount * sizeof(SaveCell) +
+                        (uint64_t)h.hazardCount * sizeof(SaveHazard) + (uint64_t)h.portalCount * sizeof(SavePortal);
+    if (size != expected) return false;
+
+    GameSettings settings;
+    settings.width = h.width;
+    settings.height = h.height;
+    settings.fruits = h.fruitsSetting;
+    settings.obstacles = h.obstaclesSetting;
+    settings.enableObstacles = h.enableObstacles;
+    settings.wrapAround = h.wrapAround;
+    settings.snakes = h.snakeCount;
+    settings.humans = h.humans;
+    settings.level = (LevelStyle)h.level;
+    settings.fruitLifetime = h.fruitLifetime;
+    settings.powerUps = h.powerUps;
+    settings.hazards = h.hazardsSetting;
+    settings.portals = h.portalsSetting;
+    auto inside = [&settings](int x, int y) { return x >= 0 && x < settings.width && y >= 0 && y < settings.height; };
+
+    const SaveSnake* snakeIn = (const SaveSnake*)(data + sizeof(SaveHeader));
+    const SaveCell* cellIn = (const SaveCell*)(snakeIn + h.snakeCount);
+    const SaveFruit* fruitIn = (const SaveFruit*)(cellIn + h.cellCount);
+    const SaveCell* obstacleIn = (const SaveCell*)(fruitIn + h.fruitCount);
+    const SaveHazard* hazardIn = (const SaveHazard*)(obstacleIn + h.obstacleCount);
+    const SavePortal* portalIn = (const SavePortal*)(hazardIn + h.hazardCount);
+
+    GameSnapshot snap;
+    snap.clock = h.clock;
+    snap.started = h.started;
+    snap.rng.state = h.rng;
+    uint64_t cells = 0;
+    for (uint32_t i = 0; i < h.snakeCount; i++) {
+        SaveSnake in;
+        memcpy(&in, snakeIn + i, sizeof(in));
+        cells += in.bodyLength;
+        if (cells > h.cellCount || in.dir < STOP || in.dir > RIGHT || in.speed <= 0 || (in.alive && in.bodyLength == 0)) return false;
+        Snake s;
+        s.dir = (Direction)in.dir;
+        s.score = in.score;
+        s.speed = in.speed;
+        s.fruitsEaten = in.fruitsEaten;
+        s.nextMoveAt = in.nextMoveAt;
+        s.alive = in.alive;
+        s.bot = in.bot;
+        for (int e = 0; e < EFFECT_COUNT; e++) s.effectEnds[e] = std::max((int64_t)0, in.effectEnds[e]);
+        for (uint32_t k = 0; k < in.bodyLength; k++) {
+            SaveCell c;
+            memcpy(&c, cellIn++, sizeof(c));
+            if (!inside(c.x, c.y)) return false;
+            s.body.push_back(Cell{ c.x, c.y });
+        }
+        snap.snakes.push_back(s);
+    }
+    if (cells != h.cellCount) return false;
+    snap.fruits.reset(settings.width, settings.height, std::max(1u, h.fruitCount));
+    for (uint32_t i = 0; i < h.fruitCount; i++) {
+        SaveFruit in;
+        memcpy(&in, fruitIn + i, sizeof(in));
+        if (!inside(in.x, in.y) || in.type < NORMAL || in.type >= FRUIT_TYPE_COUNT || in.expiresAt < 0 || snap.fruits.find(in.x, in.y)) return false;
+        snap.fruits.insert(Fruit{ in.x, in.y, (FruitType)in.type, in.expiresAt });
+    }
+    for (uint32_t i = 0; i < h.obstacleCount; i++) {
+        SaveCell c;
+        memcpy(&c, obstacleIn + i, sizeof(c));
+        if (!inside(c.x, c.y)) return false;
+    }
+    snap.entities.movedTick = h.hazardTick;
+    for (uint32_t i = 0; i < h.hazardCount; i++) {
+        SaveHazard in;
+        memcpy(&in, hazardIn + i, sizeof(in));
+        if (!inside(in.x, in.y) || in.dx < -1 || in.dx > 1 || in.dy < -1 || in.dy > 1 || in.heading < -1 || in.heading > 1 ||
+            in.patrolAt > in.patrolLength) return false;
+        Motion m = {};
+        m.dx = in.dx;
+        m.dy = in.dy;
+        m.heading = in.heading;
+        m.patrolLength = in.patrolLength;
+        m.patrolAt = in.patrolAt;
+        Entity e = snap.entities.pool.create();
+        snap.entities.position.add(e, Cell{ in.x, in.y });
+        snap.entities.motion.add(e, m);
+    }
+    for (uint32_t i = 0; i < h.portalCount; i++) {
+        SavePortal in;
+        memcpy(&in, portalIn + i, sizeof(in));
+        if (!inside(in.x, in.y) || !inside(in.exitX, in.exitY)) return false;
+        Entity e = snap.entities.pool.create();
+        snap.entities.position.add(e, Cell{ in.x, in.y });
+        snap.entities.exit.add(e, Cell{ in.exitX, in.exitY });
+    }
+
+    // Everything checked: only now is the caller's game replaced
+    core.clearBoard(settings);
+    for (uint32_t i = 0; i < h.obstacleCount; i++) core.placeObstacle(obstacleIn[i].x, obstacleIn[i].y);
+    core.restore(snap);
+    if (extras) {
+        extras->names.clear();
+        for (uint32_t i = 0; i < h.snakeCount; i++) extras->names.push_back(std::string(snakeIn[i].name, strnlen(snakeIn[i].name, SAVE_NAME_SIZE)));
+        extras->elapsedMicros = h.elapsedMicros;
+        extras->maxScore = h.maxScore;
+    }
+    return true;
+}
+
+// Written to a temporary file and renamed over the old save, so a crash
+// leaves either the old save or the new one
+inline bool writeSaveFile(const std::string& path, const GameCore& core, const SaveExtras& extras) {
+    std::string data;
+    encodeSave(core, extras, data);
+    std::string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(tmpPath.c_str());
+        return false;
+    }
+    bool ok = write(fd, data.data(), data.size()) == (ssize_t)data.size() && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        perror(path.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Maps the file and decodes it in place; false if there is no valid save
+inline bool readSaveFile(const std::string& path, GameCore& core, SaveExtras* extras = nullptr) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = false;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ok = decodeSave((const char*)p, st.st_size, core, extras);
+            munmap(p, st.st_size);
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+// Copies a game through the save format; scratch keeps its storage between
+// calls so repeated cloning doesn't allocate for the encoding
+inline void cloneGame(const GameCore& from, GameCore& to, std::string& scratch) {
+    encodeSave(from, SaveExtras(), scratch);
+    decodeSave(scratch.data(), scratch.size(), to);
+}
+
+#endif
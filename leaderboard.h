@@ -0,0 +1,363 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "netProtocol.h"
+#include "scoreStore.h"
+
+// Best score per player in each category (board size, obstacles, wrap), with
+// the top LEADERBOARD_TOP of every category and any player's rank.
+//   submit  players are sharded by name, each shard with its own lock; the
+//           score counts and the top list are locked only briefly, and the
+//           top list only for scores that reach it
+//   rank    a Fenwick tree of player counts by score: O(log maxScore), with
+//           scores capped at LEADERBOARD_MAX_SCORE so the tree stays small
+// Categories are capped at LEADERBOARD_MAX_CATEGORIES; a submit that would
+// open one more is refused, so a flood of made-up keys can't exhaust memory.
+//   top     lock-free. Writers publish an immutable snapshot of every top
+//           list (copy, update, swap the pointer, bump a version) only when
+//           a list actually changes; each reader thread keeps the snapshot
+//           it last saw and re-fetches it only after the version moves.
+// leaderboardServer serves one of these over a Unix socket so every game
+// process on a host sees the same board.
+
+const int LEADERBOARD_TOP = 10;
+const int LEADERBOARD_SHARDS = 64;
+const char* const LEADERBOARD_SOCKET = "/tmp/snakeLeaderboard.sock";
+const int LEADERBOARD_TIMEOUT_MS = 200; // a game gives up on a silent daemon after this
+const int LEADERBOARD_MAX_SCORE = 1 << 20; // far past any real game; the rank tree tops out at 16 MiB
+const size_t LEADERBOARD_MAX_CATEGORIES = 256; // so at most 4 GiB of rank trees, and far less in practice
+
+struct LeaderEntry {
+    char name[SCORE_NAME_SIZE];
+    int32_t score;
+};
+
+struct Standings {
+    bool improved;        // the submitted score became the player's best
+    long long rank;       // 1-based, 0 when the player has no score here
+    long long players;    // players ranked in the category
+    std::vector<LeaderEntry> top;
+};
+
+inline std::string leaderName(const char* name) {
+    return std::string(name, strnlen(name, SCORE_NAME_SIZE));
+}
+
+// A key some game could have sent: a board the game accepts, known flags
+inline bool validScoreKey(const ScoreKey& key) {
+    return key.width >= 5 && key.height >= 1 && key.width <= (uint32_t)MAX_BOARD_SIDE && key.height <= (uint32_t)MAX_BOARD_SIDE &&
+           (key.flags & ~(SCORE_OBSTACLES | SCORE_WRAP | SCORE_POWER_UPS)) == 0;
+}
+
+class Leaderboard {
+public:
+    Leaderboard() : id(nextId()), published(std::make_shared<const TopSnapshot>()), version(0) {}
+
+    Leaderboard(const Leaderboard&) = delete;
+    Leaderboard& operator=(const Leaderboard&) = delete;
+
+    // Keeps the score if it beats the player's best; true when it did.
+    // Scores are clamped to 0..LEADERBOARD_MAX_SCORE. False without keeping
+    // anything when the key is invalid or would open a category past the cap.
+    bool submit(const ScoreKey& key, int score) {
+        if (!validScoreKey(key)) return false;
+        score = std::max(0, std::min(score, LEADERBOARD_MAX_SCORE));
+        Category* found = category(key);
+        if (!found) return false;
+        Category& c = *found;
+        std::string name = leaderName(key.name);
+        Shard& shard = c.shards[std::hash<std::string>()(name) % LEADERBOARD_SHARDS];
+        int previous = -1;
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            std::pair<std::unordered_map<std::string, int>::iterator, bool> it = shard.best.emplace(name, score);
+            if (!it.second) {
+                if (score <= it.first->second) return false;
+                previous = it.first->second;
+                it.first->second = score;
+            }
+            // Under the shard lock, so a player's own updates reach the counts in order
+            std::lock_guard<std::mutex> countsGuard(c.countsLock);
+            if (previous >= 0) c.counts.add(previous, -1);
+            c.counts.add(score, 1);
+            if (previous < 0) c.players++;
+        }
+        if (score >= c.threshold.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard(c.topLock);
+            if (updateTop(c, key, score)) publish(categoryId(key), c.top);
+        }
+        return true;
+    }
+
+    // Players with a strictly higher best, plus one; 0 if the player has none
+    long long rank(const ScoreKey& key, long long* players = nullptr) const {
+        const Category* c = findCategory(key);
+        if (players) *players = 0;
+        if (!c) return 0;
+        std::string name = leaderName(key.name);
+        const Shard& shard = c->shards[std::hash<std::string>()(name) % LEADERBOARD_SHARDS];
+        int score;
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            std::unordered_map<std::string, int>::const_iterator it = shard.best.find(name);
+            if (it == shard.best.end()) return 0;
+            score = it->second;
+        }
+        std::lock_guard<std::mutex> guard(c->countsLock);
+        if (players) *players = c->players;
+        return 1 + c->players - c->counts.atMost(score);
+    }
+
+    // The category's top scores, best first; the key's name is ignored
+    void top(const ScoreKey& key, std::vector<LeaderEntry>& out) const {
+        struct Cache {
+            uint64_t owner;
+            uint64_t version;
+            std::shared_ptr<const TopSnapshot> snapshot;
+        };
+        static thread_local Cache cache = { 0, 0, nullptr };
+        uint64_t v = version.load(std::memory_order_acquire);
+        if (cache.owner != id || cache.version != v || !cache.snapshot) {
+            cache.snapshot = std::atomic_load_explicit(&published, std::memory_order_acquire);
+            cache.owner = id;
+            cache.version = v;
+        }
+        out.clear();
+        TopSnapshot::const_iterator it = cache.snapshot->find(categoryId(key));
+        if (it != cache.snapshot->end()) out = it->second;
+    }
+
+    // Submits (when score >= 0) and reads back where the player stands
+    Standings standings(const ScoreKey& key, int score) {
+        Standings s;
+        s.improved = score >= 0 && submit(key, score);
+        s.rank = rank(key, &s.players);
+        top(key, s.top);
+        return s;
+    }
+
+    // Seeds the board with everything a score store holds
+    void load(const ScoreStore& store) {
+        store.forEach([this](const ScoreKey& key, int score) { submit(key, score); });
+    }
+
+private:
+    typedef std::unordered_map<uint64_t, std::vector<LeaderEntry>> TopSnapshot;
+
+    // Player counts by score. Grows by doubling: with a power-of-two size the
+    // new upper half starts empty except its last node, which covers all.
+    class Fenwick {
+    public:
+        Fenwick() : tree(1 + 1024, 0) {}
+
+        void add(int score, int delta) {
+            while ((size_t)score + 1 >= tree.size()) {
+                size_t n = tree.size() - 1;
+                tree.resize(2 * n + 1, 0);
+                tree[2 * n] = tree[n];
+            }
+            for (size_t i = score + 1; i < tree.size(); i += i & -i) tree[i] += delta;
+        }
+
+        // Players whose best is <= score
+        long long atMost(int score) const {
+            long long sum = 0;
+            for (size_t i = std::min((size_t)score + 1, tree.size() - 1); i > 0; i -= i & -i) sum += tree[i];
+            return sum;
+        }
+
+    private:
+        std::vector<long long> tree; // 1-based
+    };
+
+    struct Shard {
+        mutable std::mutex lock;
+        std::unordered_map<std::string, int> best;
+    };
+
+    struct Category {
+        Shard shards[LEADERBOARD_SHARDS];
+        mutable std::mutex countsLock;
+        Fenwick counts;
+        long long players = 0;
+        std::mutex topLock;
+        std::vector<LeaderEntry> top;      // the published list, kept in step with best
+        std::atomic<int> threshold{0};     // scores below this can't reach a full list
+    };
+
+    uint64_t id;  // tells this board's snapshots apart in the reader cache
+    mutable std::shared_mutex categoriesLock;
+    std::unordered_map<uint64_t, std::unique_ptr<Category>> categories;
+    std::mutex publishLock;
+    std::shared_ptr<const TopSnapshot> published;
+    std::atomic<uint64_t> version;
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
+
+    // Unique for valid keys: heights below 2^24 and flags below 2^8
+    static uint64_t categoryId(const ScoreKey& key) {
+        return ((uint64_t)key.width << 32) | ((uint64_t)key.height << 8) | key.flags;
+    }
+
+    const Category* findCategory(const ScoreKey& key) const {
+        std::shared_lock<std::shared_mutex> guard(categoriesLock);
+        std::unordered_map<uint64_t, std::unique_ptr<Category>>::const_iterator it = categories.find(categoryId(key));
+        return it == categories.end() ? nullptr : it->second.get();
+    }
+
+    // Finds or opens the key's category; null when opening it would pass the cap
+    Category* category(const ScoreKey& key) {
+        const Category* found = findCategory(key);
+        if (found) return const_cast<Category*>(found);
+        std::unique_lock<std::shared_mutex> guard(categoriesLock);
+        std::unordered_map<uint64_t, std::unique_ptr<Category>>::iterator it = categories.find(categoryId(key));
+        if (it != categories.end()) return it->second.get();
+        if (categories.size() >= LEADERBOARD_MAX_CATEGORIES) return nullptr;
+        std::unique_ptr<Category>& c = categories[categoryId(key)];
+        c.reset(new Category());
+        return c.get();
+    }
+
+    static bool ahead(const LeaderEntry& a, const LeaderEntry& b) {
+        return a.score != b.score ? a.score > b.score : memcmp(a.name, b.name, SCORE_NAME_SIZE) < 0;
+    }
+
+    // Best first, ties by name; false when the list didn't change
+    static bool updateTop(Category& c, const ScoreKey& key, int score) {
+        std::vector<LeaderEntry>& top = c.top;
+        LeaderEntry e;
+        memcpy(e.name, key.name, SCORE_NAME_SIZE);
+        e.score = score;
+        std::vector<LeaderEntry>::iterator old = top.begin();
+        while (old != top.end() && memcmp(old->name, key.name, SCORE_NAME_SIZE) != 0) ++old;
+        if (old != top.end() && old->score >= score) return false; // a racing submit got there first
+        if (old == top.end() && (int)top.size() >= LEADERBOARD_TOP && !ahead(e, top.back())) return false;
+        if (old != top.end()) top.erase(old);
+        top.insert(std::upper_bound(top.begin(), top.end(), e, ahead), e);
+        if ((int)top.size() > LEADERBOARD_TOP) top.pop_back();
+        if ((int)top.size() == LEADERBOARD_TOP) c.threshold.store(top.back().score, std::memory_order_relaxed);
+        return true;
+    }
+
+    void publish(uint64_t category, const std::vector<LeaderEntry>& top) {
+        std::lock_guard<std::mutex> guard(publishLock);
+        std::shared_ptr<TopSnapshot> next = std::make_shared<TopSnapshot>(*published);
+        (*next)[category] = top;
+        std::atomic_store_explicit(&published, std::shared_ptr<const TopSnapshot>(next), std::memory_order_release);
+        version.fetch_add(1, std::memory_order_release);
+    }
+};
+
+// Wire form of the daemon's messages (see MSG_SUBMIT in netProtocol.h)
+inline void writeScoreKey(MessageWriter& w, const ScoreKey& key) {
+    w.str(leaderName(key.name));
+    w.u32(key.width);
+    w.u32(key.height);
+    w.u8(key.flags);
+}
+
+inline ScoreKey readScoreKey(MessageReader& r) {
+    ScoreKey key;
+    memset(&key, 0, sizeof(key));
+    std::string name = r.str();
+    memcpy(key.name, name.data(), std::min(name.size(), (size_t)SCORE_NAME_SIZE));
+    key.width = r.u32();
+    key.height = r.u32();
+    key.flags = r.u8();
+    return key;
+}
+
+inline void writeStandings(std::string& out, const Standings& s) {
+    MessageWriter w(out);
+    w.begin(MSG_STANDINGS);
+    w.u8(s.improved);
+    w.i64(s.rank);
+    w.i64(s.players);
+    w.u8(s.top.size());
+    for (const LeaderEntry& e : s.top) {
+        w.str(leaderName(e.name));
+        w.i32(e.score);
+    }
+    w.end();
+}
+
+inline bool readStandings(MessageReader& r, Standings& s) {
+    s.improved = r.u8() != 0;
+    s.rank = r.i64();
+    s.players = r.i64();
+    int count = r.u8();
+    s.top.clear();
+    for (int i = 0; i < count && r.good(); i++) {
+        LeaderEntry e;
+        memset(e.name, 0, sizeof(e.name));
+        std::string name = r.str();
+        memcpy(e.name, name.data(), std::min(name.size(), (size_t)SCORE_NAME_SIZE));
+        e.score = r.i32();
+        s.top.push_back(e);
+    }
+    return r.good();
+}
+
+// One round trip to the daemon: submits the score (skipped when negative)
+// and fills in the standings. False if no daemon answers in time.
+inline bool askLeaderboard(const std::string& socketPath, const ScoreKey& key, int score, Standings& s) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    struct timeval timeout = { 0, LEADERBOARD_TIMEOUT_MS * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    std::string out, in;
+    MessageWriter w(out);
+    w.begin(score >= 0 ? MSG_SUBMIT : MSG_STANDINGS_QUERY);
+    writeScoreKey(w, key);
+    if (score >= 0) w.i32(score);
+    w.end();
+
+    bool ok = false;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+        send(fd, out.data(), out.size(), MSG_NOSIGNAL) == (ssize_t)out.size()) {
+        char buf[4096];
+        size_t pos = 0;
+        uint8_t type;
+        const char* payload;
+        size_t size;
+        bool bad = false;
+        while (!ok && !bad) {
+            ssize_t got = recv(fd, buf, sizeof(buf), 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) break;
+            in.append(buf, got);
+            if (nextMessage(in, pos, type, payload, size, bad)) {
+                MessageReader r(payload, size);
+                ok = type == MSG_STANDINGS && readStandings(r, s);
+                break;
+            }
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "leaderboard.h"
+
+using namespace std;
+
+// Checks the leaderboard against scores no game can reach: they must not
+// grow the rank tree past LEADERBOARD_MAX_SCORE (INT_MAX used to ask for
+// 16 GiB and throw), and they still rank above every real score. Made-up
+// boards and flags are refused, and so are categories past the cap.
+
+int failures = 0;
+
+void expect(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "leaderboardCheck: %s\n", what);
+        failures++;
+    }
+}
+
+ScoreKey player(const string& name, int width = WIDTH, int height = HEIGHT) {
+    GameSettings settings;
+    settings.width = width;
+    settings.height = height;
+    return makeScoreKey(name, settings);
+}
+
+// Usage: leaderboardCheck
+int main() {
+    Leaderboard board;
+    board.submit(player("alice"), 120);
+    board.submit(player("bob"), 80);
+
+    expect(board.submit(player("mallory"), INT_MAX), "a huge score isn't kept");
+    expect(board.submit(player("trent"), LEADERBOARD_MAX_SCORE + 1), "a score just past the cap isn't kept");
+    expect(!board.submit(player("mallory"), LEADERBOARD_MAX_SCORE), "a capped best is beaten by the cap itself");
+
+    long long players = 0;
+    expect(board.rank(player("mallory"), &players) == 1, "a huge score doesn't rank first");
+    expect(players == 4, "the category lost count of its players");
+    expect(board.rank(player("alice")) == 3, "real scores rank wrong behind huge ones");
+    expect(board.rank(player("bob")) == 4, "the lowest score doesn't rank last");
+
+    vector<LeaderEntry> top;
+    board.top(player(""), top);
+    expect(!top.empty() && top[0].score == LEADERBOARD_MAX_SCORE, "the top list holds a score past the cap");
+
+    expect(board.submit(player("bob"), -5) == false, "a negative score beat a real best");
+
+    ScoreKey bad = player("eve");
+    bad.flags = 0x80;
+    expect(!validScoreKey(bad) && !board.submit(bad, 10), "unknown flags opened a category");
+    expect(!board.submit(player("eve", MAX_BOARD_SIDE + 1, 10), 10), "a board wider than the game allows opened a category");
+    expect(!board.submit(player("eve", 10, 0), 10), "a board with no rows opened a category");
+
+    // The default board is open already; fill up to the cap with others
+    size_t opened = 1;
+    for (int w = 5; opened < LEADERBOARD_MAX_CATEGORIES; w++, opened++) {
+        expect(board.submit(player("eve", w, 7), 10), "a category under the cap was refused");
+    }
+    expect(!board.submit(player("eve", 5, 8), 10), "a category past the cap was opened");
+    expect(board.rank(player("eve", 5, 8)) == 0, "a refused submit left a rank behind");
+    expect(board.submit(player("zed", 5, 7), 20), "a full board refused a submit to an open category");
+
+    if (failures) return 1;
+    printf("leaderboardCheck: huge scores are capped and ranked, bad keys and extra categories refused\n");
+    return 0;
+}
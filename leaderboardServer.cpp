@@ -0,0 +1,269 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include "leaderboard.h"
+
+using namespace std;
+
+// Host-wide leaderboard daemon. Game processes connect over a Unix socket,
+// submit a finished game and read back the category's top list and their
+// rank in one round trip. Every worker waits on the listening socket with
+// EPOLLEXCLUSIVE and serves the connections it accepts; they all share one
+// Leaderboard, whose top lists are read without locks. Improved bests are
+// also written to a score store so a restart loses nothing.
+
+const size_t MAX_REQUEST_BUFFER = 64 << 10; // a client sending more than this is dropped
+
+struct DaemonStats {
+    atomic<long long> connections{0};
+    atomic<long long> submissions{0};
+    atomic<long long> improved{0};
+    atomic<long long> queries{0};
+};
+
+class LeaderboardWorker {
+public:
+    LeaderboardWorker(int listenFd, Leaderboard& board, ScoreStore& store, mutex& storeLock, DaemonStats& stats)
+        : listenFd(listenFd), board(board), store(store), storeLock(storeLock), stats(stats) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) {
+            perror("worker");
+            exit(1);
+        }
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    }
+
+    ~LeaderboardWorker() {
+        for (auto& c : clients) close(c.first);
+        close(epollFd);
+        close(wakeFd);
+    }
+
+    void start() { thread = std::thread(&LeaderboardWorker::run, this); }
+
+    void stop() {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) perror("stop");
+        thread.join();
+    }
+
+private:
+    int listenFd;
+    Leaderboard& board;
+    ScoreStore& store;
+    mutex& storeLock;
+    DaemonStats& stats;
+    int epollFd, wakeFd;
+    std::thread thread;
+    unordered_map<int, string> clients; // fd -> bytes received so far
+
+    void run() {
+        while (true) {
+            struct epoll_event events[64];
+            int n = epoll_wait(epollFd, events, 64, -1);
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd) return;
+                if (fd == listenFd) {
+                    accept();
+                } else {
+                    receive(fd);
+                }
+            }
+        }
+    }
+
+    void accept() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+            clients[fd];
+            stats.connections++;
+        }
+    }
+
+    void receive(int fd) {
+        string& in = clients[fd];
+        char buf[4096];
+        while (true) {
+            ssize_t got = read(fd, buf, sizeof(buf));
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (got <= 0 || in.size() + got > MAX_REQUEST_BUFFER) {
+                drop(fd);
+                return;
+            }
+            in.append(buf, got);
+        }
+
+        size_t pos = 0;
+        uint8_t type;
+        const char* payload;
+        size_t size;
+        bool bad = false;
+        string out;
+        while (nextMessage(in, pos, type, payload, size, bad)) {
+            MessageReader r(payload, size);
+            ScoreKey key = readScoreKey(r);
+            int score = type == MSG_SUBMIT ? r.i32() : -1;
+            // A board, flags or score no game can produce is a broken or hostile client
+            if (!r.good() || (type != MSG_SUBMIT && type != MSG_STANDINGS_QUERY) || !validScoreKey(key) ||
+                score > LEADERBOARD_MAX_SCORE) {
+                bad = true;
+                break;
+            }
+            Standings s = board.standings(key, score);
+            if (type == MSG_SUBMIT) {
+                stats.submissions++;
+            } else {
+                stats.queries++;
+            }
+            if (s.improved) {
+                stats.improved++;
+                lock_guard<mutex> guard(storeLock);
+                store.record(key, score);
+            }
+            writeStandings(out, s);
+        }
+        if (bad) {
+            drop(fd);
+            return;
+        }
+        in.erase(0, pos);
+        // Replies are a few hundred bytes: a socket that can't take one is stuck
+        if (!out.empty() && send(fd, out.data(), out.size(), MSG_NOSIGNAL) != (ssize_t)out.size()) drop(fd);
+    }
+
+    void drop(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        clients.erase(fd);
+        stats.connections--;
+    }
+};
+
+int listenOnSocket(const string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4096) < 0) {
+        perror("listen");
+        exit(1);
+    }
+    chmod(path.c_str(), 0666); // every game process on the host may submit
+    return fd;
+}
+
+// Usage: leaderboardServer [--socket PATH] [--scores PATH] [--workers N]
+int main(int argc, char* argv[]) {
+    string socketPath = LEADERBOARD_SOCKET;
+    const char* home = getenv("HOME");
+    string scoresPath = string(home ? home : ".") + "/.snakeLeaderboard";
+    int workerCount = 0;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--scores" && i + 1 < argc) {
+            scoresPath = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            workerCount = max(1, atoi(argv[++i]));
+        } else {
+            cerr << "Usage: " << argv[0] << " [--socket PATH] [--scores PATH] [--workers N]" << endl;
+            return 1;
+        }
+    }
+    if (workerCount == 0) workerCount = max(1u, std::thread::hardware_concurrency());
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int signalFd = signalfd(-1, &mask, SFD_CLOEXEC);
+
+    ScoreStore store(scoresPath);
+    mutex storeLock;
+    Leaderboard board;
+    board.load(store);
+
+    DaemonStats stats;
+    int listenFd = listenOnSocket(socketPath);
+    vector<LeaderboardWorker*> workers;
+    for (int i = 0; i < workerCount; i++) workers.push_back(new LeaderboardWorker(listenFd, board, store, storeLock, stats));
+    for (LeaderboardWorker* w : workers) w->start();
+
+    int statsFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    struct itimerspec second = {};
+    second.it_value.tv_sec = 1;
+    second.it_interval.tv_sec = 1;
+    timerfd_settime(statsFd, 0, &second, nullptr);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (int fd : { signalFd, statsFd }) {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    cerr << "Leaderboard on " << socketPath << " with " << workerCount << " workers" << endl;
+
+    long long lastSubmissions = 0, lastImproved = 0, lastQueries = 0;
+    bool running = true;
+    while (running) {
+        struct epoll_event events[2];
+        int n = epoll_wait(epollFd, events, 2, -1);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == signalFd) {
+                running = false;
+                continue;
+            }
+            uint64_t expirations;
+            if (read(statsFd, &expirations, sizeof(expirations)) < 0) continue;
+            long long submissions = stats.submissions, improved = stats.improved, queries = stats.queries;
+            if (submissions == lastSubmissions && queries == lastQueries) continue;
+            fprintf(stderr, "conns %lld | submissions/s %lld (%lld new bests) | queries/s %lld\n",
+                    stats.connections.load(), submissions - lastSubmissions, improved - lastImproved, queries - lastQueries);
+            lastSubmissions = submissions;
+            lastImproved = improved;
+            lastQueries = queries;
+        }
+    }
+
+    for (LeaderboardWorker* w : workers) w->stop();
+    for (LeaderboardWorker* w : workers) delete w;
+    close(listenFd);
+    unlink(socketPath.c_str());
+    close(statsFd);
+    close(signalFd);
+    close(epollFd);
+    return 0;
+}
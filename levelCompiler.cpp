@@ -0,0 +1,265 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "snakeCore.h"
+
+using namespace std;
+
+// Compiles a text level into the binary map the game and server load with
+// --map (see levelMap.h). The text is a list of directives, one per line;
+// '#' starts a comment:
+//
+//   size 60 30              board size; must come first
+//   wrap                    edges wrap around
+//   wall X0 Y0 X1 Y1        a filled rectangle of wall, corners inclusive
+//   start X Y               a snake's head, facing right, body trailing two
+//                           cells left; player one's is the first
+//   fruit X0 Y0 X1 Y1       a fruit spawn zone; with none, fruits go anywhere
+//   map X Y                 the lines up to "end" are drawn from (X, Y):
+//                           '#' wall, 'S' start, 'F' fruit zone, '.' or ' ' free
+//
+// The compiler checks that every start is on the board with its body clear
+// and that all starts are joined. Free cells they can't reach are walled up
+// and dropped from the fruit zones, with a warning.
+
+struct MapSource {
+    string path;
+    int width = 0, height = 0, wordsPerRow = 0;
+    bool wrapAround = false;
+    vector<uint64_t> walls, zones; // bitboards
+    vector<MapStart> starts;
+};
+
+[[noreturn]] void fail(const MapSource& src, int line, const string& message) {
+    cerr << src.path;
+    if (line > 0) cerr << ":" << line;
+    cerr << ": " << message << endl;
+    exit(1);
+}
+
+void setBit(vector<uint64_t>& bits, const MapSource& src, int x, int y, bool on) {
+    uint64_t& word = bits[(size_t)y * src.wordsPerRow + (x >> 6)];
+    if (on) word |= uint64_t(1) << (x & 63);
+    else word &= ~(uint64_t(1) << (x & 63));
+}
+
+bool testBit(const vector<uint64_t>& bits, const MapSource& src, int x, int y) {
+    return (bits[(size_t)y * src.wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+}
+
+void parse(MapSource& src, istream& in) {
+    string text;
+    int line = 0;
+    while (getline(in, text)) {
+        line++;
+        text = text.substr(0, text.find('#'));
+        istringstream words(text);
+        string directive;
+        if (!(words >> directive)) continue;
+        if (directive != "size" && src.width == 0) fail(src, line, "the first directive must be size");
+
+        auto inside = [&](int x, int y) { return x >= 0 && x < src.width && y >= 0 && y < src.height; };
+        if (directive == "size") {
+            if (src.width) fail(src, line, "size given twice");
+            if (!(words >> src.width >> src.height) || src.width < 5 || src.height < 1 ||
+                (long long)src.width * src.height > MAX_LEVEL_CELLS) {
+                fail(src, line, "size expects W H, at least 5 1 and at most " + to_string(MAX_LEVEL_CELLS) + " cells");
+            }
+            src.wordsPerRow = (src.width + 63) / 64;
+            src.walls.assign((size_t)src.wordsPerRow * src.height, 0);
+            src.zones.assign(src.walls.size(), 0);
+        } else if (directive == "wrap") {
+            src.wrapAround = true;
+        } else if (directive == "wall" || directive == "fruit") {
+            int x0, y0, x1, y1;
+            if (!(words >> x0 >> y0 >> x1 >> y1) || !inside(x0, y0) || !inside(x1, y1) || x0 > x1 || y0 > y1) {
+                fail(src, line, directive + " expects X0 Y0 X1 Y1 on the board, top left first");
+            }
+            vector<uint64_t>& bits = directive == "wall" ? src.walls : src.zones;
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) setBit(bits, src, x, y, true);
+            }
+        } else if (directive == "start") {
+            MapStart s;
+            if (!(words >> s.x >> s.y) || !inside(s.x, s.y)) fail(src, line, "start expects X Y on the board");
+            src.starts.push_back(s);
+        } else if (directive == "map") {
+            int x0, y0;
+            if (!(words >> x0 >> y0) || !inside(x0, y0)) fail(src, line, "map expects X Y on the board");
+            int y = y0;
+            bool ended = false;
+            while (getline(in, text)) {
+                line++;
+                if (text == "end") {
+                    ended = true;
+                    break;
+                }
+                if (y >= src.height) fail(src, line, "map runs past the bottom of the board");
+                if (x0 + (int)text.size() > src.width) fail(src, line, "map row runs past the right edge of the board");
+                for (int k = 0; k < (int)text.size(); k++) {
+                    int x = x0 + k;
+                    char c = text[k];
+                    if (c == '#') {
+                        setBit(src.walls, src, x, y, true);
+                    } else if (c == 'S') {
+                        src.starts.push_back(MapStart{ x, y });
+                    } else if (c == 'F') {
+                        setBit(src.zones, src, x, y, true);
+                    } else if (c != '.' && c != ' ') {
+                        fail(src, line, string("unknown map cell '") + c + "'");
+                    }
+                }
+                y++;
+            }
+            if (!ended) fail(src, line, "map without end");
+        } else {
+            fail(src, line, "unknown directive " + directive);
+        }
+        string extra;
+        if (directive != "map" && words >> extra) fail(src, line, "unexpected " + extra);
+    }
+    if (src.width == 0) fail(src, line, "no size");
+}
+
+// Checks the starts and walls up whatever they can't reach
+void settle(MapSource& src) {
+    if (src.starts.empty()) fail(src, 0, "no start");
+    if ((int)src.starts.size() > MAX_SNAKES) fail(src, 0, "more than " + to_string(MAX_SNAKES) + " starts");
+    vector<uint64_t> bodies(src.walls.size(), 0);
+    for (const MapStart& s : src.starts) {
+        for (int k = 0; k < 3; k++) {
+            int x = s.x - k;
+            if (x < 0 || testBit(src.walls, src, x, s.y) || testBit(bodies, src, x, s.y)) {
+                fail(src, 0, "the snake starting at " + to_string(s.x) + "," + to_string(s.y) + " doesn't fit there");
+            }
+            setBit(bodies, src, x, s.y, true);
+        }
+        if (s.x + 1 < src.width && testBit(src.walls, src, s.x + 1, s.y)) {
+            cerr << src.path << ": warning: the snake starting at " << s.x << "," << s.y << " faces a wall" << endl;
+        }
+    }
+
+    int w = src.width, h = src.height;
+    DisjointSets sets;
+    sets.reset((size_t)w * h);
+    auto open = [&](int x, int y) { return !testBit(src.walls, src, x, y); };
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (!open(x, y)) continue;
+            uint32_t i = (uint32_t)y * w + x;
+            if (x + 1 < w && open(x + 1, y)) sets.unite(i, i + 1);
+            if (y + 1 < h && open(x, y + 1)) sets.unite(i, i + w);
+            if (src.wrapAround && x == 0 && open(w - 1, y)) sets.unite(i, i + w - 1);
+            if (src.wrapAround && y == 0 && open(x, h - 1)) sets.unite(i, (uint32_t)(h - 1) * w + x);
+        }
+    }
+    uint32_t keep = sets.find((uint32_t)src.starts[0].y * w + src.starts[0].x);
+    for (const MapStart& s : src.starts) {
+        if (sets.find((uint32_t)s.y * w + s.x) != keep) fail(src, 0, "the starts are walled off from each other");
+    }
+
+    long long stranded = 0, droppedZone = 0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (!open(x, y)) {
+                if (testBit(src.zones, src, x, y)) droppedZone++;
+                setBit(src.zones, src, x, y, false);
+            } else if (sets.find((uint32_t)y * w + x) != keep) {
+                stranded++;
+                if (testBit(src.zones, src, x, y)) droppedZone++;
+                setBit(src.walls, src, x, y, true);
+                setBit(src.zones, src, x, y, false);
+            }
+        }
+    }
+    if (stranded) cerr << src.path << ": warning: " << stranded << " free cells can't be reached from the starts; walled up" << endl;
+    if (droppedZone) cerr << src.path << ": warning: " << droppedZone << " fruit zone cells are walls or unreachable; dropped" << endl;
+}
+
+// Fruit zones as runs of consecutive cells along each row
+vector<FruitRun> zoneRuns(const MapSource& src) {
+    vector<FruitRun> runs;
+    uint32_t cells = 0;
+    for (int y = 0; y < src.height; y++) {
+        for (int x = 0; x < src.width; ) {
+            if (!testBit(src.zones, src, x, y)) {
+                x++;
+                continue;
+            }
+            FruitRun r = { x, y, 0, cells };
+            while (x < src.width && testBit(src.zones, src, x, y)) {
+                r.length++;
+                x++;
+            }
+            cells += r.length;
+            runs.push_back(r);
+        }
+    }
+    return runs;
+}
+
+// Usage: levelCompiler LEVEL.txt OUT.map
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " LEVEL.txt OUT.map" << endl;
+        return 1;
+    }
+    MapSource src;
+    src.path = argv[1];
+    ifstream in(argv[1]);
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    bool zonesGiven = false;
+    parse(src, in);
+    for (uint64_t word : src.zones) zonesGiven |= word != 0;
+    settle(src);
+    vector<FruitRun> runs = zoneRuns(src);
+    if (zonesGiven && runs.empty()) fail(src, 0, "no fruit zone cell is left");
+
+    LevelMapHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = LEVEL_MAP_MAGIC;
+    h.version = LEVEL_MAP_VERSION;
+    h.headerSize = sizeof(LevelMapHeader);
+    h.width = src.width;
+    h.height = src.height;
+    h.wordsPerRow = src.wordsPerRow;
+    h.startCount = src.starts.size();
+    h.runCount = runs.size();
+    h.zoneCells = runs.empty() ? 0 : runs.back().before + runs.back().length;
+    h.wrapAround = src.wrapAround;
+
+    string out((const char*)&h, sizeof(h));
+    out.append((const char*)src.starts.data(), src.starts.size() * sizeof(MapStart));
+    out.append((const char*)runs.data(), runs.size() * sizeof(FruitRun));
+    out.append((const char*)src.walls.data(), src.walls.size() * sizeof(uint64_t));
+
+    // Written next to the target and renamed over it once complete
+    string path = argv[2], tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(tmpPath.c_str());
+        return 1;
+    }
+    bool ok = write(fd, out.data(), out.size()) == (ssize_t)out.size() && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        perror(path.c_str());
+        unlink(tmpPath.c_str());
+        return 1;
+    }
+    size_t walls = 0;
+    for (uint64_t word : src.walls) walls += __builtin_popcountll(word);
+    printf("%s: %dx%d%s, %zu walls, %zu starts, %llu fruit zone cells in %zu runs\n", path.c_str(), src.width, src.height,
+           src.wrapAround ? " wrapping" : "", walls, src.starts.size(), (unsigned long long)h.zoneCells, runs.size());
+    return 0;
+}
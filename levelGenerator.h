@@ -0,0 +1,355 @@
+#ifndef LEVEL_GENERATOR_H
+#define LEVEL_GENERATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Obstacle layouts: scattered blocks, wall segments, rooms with doors and
+// mazes. A layout is drawn on a bitboard (one bit per cell, a row of 64-bit
+// words per board row), the start zones are cleared, and the free cells are
+// joined into regions with union-find. A layout that splits the start zones
+// or strands more than a tenth of the free cells is thrown away and drawn
+// again; otherwise the stranded pockets are walled up. Every free cell of an
+// accepted level is reachable from every start. The generator keeps its
+// buffers between levels, so a batch of small levels runs without allocating.
+
+enum LevelStyle { LEVEL_SCATTER = 0, LEVEL_WALLS, LEVEL_ROOMS, LEVEL_MAZE, LEVEL_STYLE_COUNT };
+
+const char* const LEVEL_STYLE_NAMES[] = { "scatter", "walls", "rooms", "maze" };
+
+const long long MAX_LEVEL_CELLS = 1 << 22; // bigger boards are too large to validate (see GameCore::spawnObstacles)
+const int LEVEL_ATTEMPTS = 8;              // layouts drawn before settling for an empty board
+const int MIN_REACHABLE_PERCENT = 90;      // of the free cells, or the layout is redrawn
+const int ROOM_MIN_SIDE = 8;
+const int DOOR_WIDTH = 3;
+const int MAZE_PITCH = 4;                  // corridors 3 cells wide between 1-cell walls
+const int MAZE_LOOP_PERCENT = 15;          // extra openings, so a maze has loops and fewer dead ends
+
+inline bool parseLevelStyle(const std::string& name, LevelStyle& style) {
+    for (int i = 0; i < LEVEL_STYLE_COUNT; i++) {
+        if (name == LEVEL_STYLE_NAMES[i]) {
+            style = (LevelStyle)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Union-find over dense indices with path halving; the lower index of two
+// joined sets becomes the root, so results don't depend on union order
+class DisjointSets {
+public:
+    void reset(size_t n) {
+        parent.resize(n);
+        for (size_t i = 0; i < n; i++) parent[i] = i;
+    }
+
+    uint32_t find(uint32_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    bool unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (a < b) parent[b] = a;
+        else parent[a] = b;
+        return true;
+    }
+
+private:
+    std::vector<uint32_t> parent;
+};
+
+struct LevelStats {
+    int attempts;  // layouts drawn, the accepted one included
+    int filled;    // stranded free cells walled up
+    size_t walls;
+};
+
+class LevelGenerator {
+public:
+    LevelGenerator() : width(0), height(0), wordsPerRow(0), wrapAround(false) {}
+
+    // Starts a level for a width x height board; width * height must not
+    // exceed MAX_LEVEL_CELLS
+    void begin(int w, int h, bool wrap) {
+        width = w;
+        height = h;
+        wordsPerRow = (w + 63) >> 6;
+        wrapAround = wrap;
+        zones.clear();
+    }
+
+    // A rectangle (inclusive, clipped to the board) that stays free and
+    // reachable: where a snake starts and the cells of its first moves
+    void keepClear(int x0, int y0, int x1, int y1) {
+        Zone z = { std::max(0, x0), std::max(0, y0), std::min(width - 1, x1), std::min(height - 1, y1) };
+        if (z.x0 <= z.x1 && z.y0 <= z.y1) zones.push_back(z);
+    }
+
+    // Draws layouts until one passes. amount is the number of obstacle cells
+    // for scatter and walls (0 = a default for the board size); rooms and
+    // mazes fill the board. rng needs below(n).
+    template <class Rng>
+    LevelStats generate(LevelStyle style, int amount, Rng& rng) {
+        LevelStats stats = { 0, 0, 0 };
+        for (int attempt = 0; attempt < LEVEL_ATTEMPTS; attempt++) {
+            stats.attempts++;
+            bits.assign((size_t)wordsPerRow * height, 0);
+            if (style == LEVEL_WALLS) {
+                drawWalls(amount, rng);
+            } else if (style == LEVEL_ROOMS) {
+                drawRooms(rng);
+            } else if (style == LEVEL_MAZE) {
+                drawMaze(rng);
+            } else {
+                drawScatter(amount, rng);
+            }
+            for (const Zone& z : zones) clearRect(z.x0, z.y0, z.x1, z.y1);
+            stats.filled = settle(attempt == LEVEL_ATTEMPTS - 1);
+            if (stats.filled >= 0) break;
+        }
+        if (stats.filled < 0) {
+            bits.assign(bits.size(), 0);
+            stats.filled = 0;
+        }
+        stats.walls = wallCount();
+        return stats;
+    }
+
+    bool isWall(int x, int y) const { return (bits[(size_t)y * wordsPerRow + (x >> 6)] >> (x & 63)) & 1; }
+
+    // Calls fn(x, y) for every wall cell, row by row
+    template <class Fn>
+    void forEachWall(Fn fn) const {
+        for (int y = 0; y < height; y++) {
+            for (int w = 0; w < wordsPerRow; w++) {
+                uint64_t word = bits[(size_t)y * wordsPerRow + w];
+                while (word) {
+                    int bit = __builtin_ctzll(word);
+                    word &= word - 1;
+                    fn((w << 6) + bit, y);
+                }
+            }
+        }
+    }
+
+    size_t wallCount() const {
+        size_t n = 0;
+        for (uint64_t word : bits) n += __builtin_popcountll(word);
+        return n;
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const std::vector<uint64_t>& getBits() const { return bits; } // wordsPerRow words per row, bit x of a row is cell x
+
+private:
+    struct Zone {
+        int x0, y0, x1, y1;
+    };
+
+    int width, height, wordsPerRow;
+    bool wrapAround;
+    std::vector<Zone> zones;
+    std::vector<uint64_t> bits;     // set = wall
+    DisjointSets sets;              // cells while settling, maze nodes while drawing
+    std::vector<uint32_t> counts;   // region sizes, when there is no zone to anchor on
+    std::vector<uint32_t> edges;    // maze edges in shuffled order
+    std::vector<Zone> rooms;        // rooms still to be split
+
+    void setWall(int x, int y) { bits[(size_t)y * wordsPerRow + (x >> 6)] |= uint64_t(1) << (x & 63); }
+    void clearWall(int x, int y) { bits[(size_t)y * wordsPerRow + (x >> 6)] &= ~(uint64_t(1) << (x & 63)); }
+
+    void clearRect(int x0, int y0, int x1, int y1) {
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) clearWall(x, y);
+        }
+    }
+
+    bool inZone(int x, int y) const {
+        for (const Zone& z : zones) {
+            if (x >= z.x0 && x <= z.x1 && y >= z.y0 && y <= z.y1) return true;
+        }
+        return false;
+    }
+
+    // Single blocks that touch neither another block nor the edge, so they
+    // can't close anything off by themselves. Once one finds no room, the
+    // board is full enough.
+    template <class Rng>
+    void drawScatter(int amount, Rng& rng) {
+        if (width < 3 || height < 3) return;
+        int count = amount ? amount : 8 + rng.below(25);
+        for (int i = 0; i < count; i++) {
+            int attempt = 0;
+            for (; attempt < 100; attempt++) {
+                int x = 1 + rng.below(width - 2), y = 1 + rng.below(height - 2);
+                if (inZone(x, y) || isWall(x - 1, y - 1) || isWall(x, y - 1) || isWall(x + 1, y - 1) || isWall(x - 1, y) ||
+                    isWall(x + 1, y) || isWall(x - 1, y + 1) || isWall(x, y + 1) || isWall(x + 1, y + 1)) continue;
+                setWall(x, y);
+                break;
+            }
+            if (attempt == 100) break;
+        }
+    }
+
+    // Straight segments in both directions; they may cross and box things in
+    template <class Rng>
+    void drawWalls(int amount, Rng& rng) {
+        long long target = std::min((long long)width * height, amount ? amount : (long long)width * height / 16);
+        int longest = std::max(1, std::min(width, height) / 3);
+        long long placed = 0;
+        for (long long tries = 0; placed < target && tries < target * 4; tries++) {
+            bool across = rng.below(2);
+            int length = 3 + rng.below(longest);
+            int x = rng.below(width), y = rng.below(height);
+            for (int k = 0; k < length && x < width && y < height && placed < target; k++) {
+                if (!isWall(x, y)) {
+                    setWall(x, y);
+                    placed++;
+                }
+                if (across) x++;
+                else y++;
+            }
+        }
+    }
+
+    // Recursive division: each room is split by a wall with a door until the
+    // rooms are smaller than twice ROOM_MIN_SIDE
+    template <class Rng>
+    void drawRooms(Rng& rng) {
+        rooms.assign(1, Zone{ 0, 0, width - 1, height - 1 });
+        while (!rooms.empty()) {
+            Zone r = rooms.back();
+            rooms.pop_back();
+            int w = r.x1 - r.x0 + 1, h = r.y1 - r.y0 + 1;
+            bool splitX = w > 2 * ROOM_MIN_SIDE, splitY = h > 2 * ROOM_MIN_SIDE;
+            if (!splitX && !splitY) continue;
+            if (splitX && splitY) splitX = w >= h;
+            if (splitX) {
+                int x = r.x0 + ROOM_MIN_SIDE + rng.below(w - 2 * ROOM_MIN_SIDE);
+                for (int y = r.y0; y <= r.y1; y++) setWall(x, y);
+                int door = r.y0 + rng.below(std::max(1, h - DOOR_WIDTH + 1));
+                for (int y = door; y < door + DOOR_WIDTH && y <= r.y1; y++) clearWall(x, y);
+                rooms.push_back(Zone{ r.x0, r.y0, x - 1, r.y1 });
+                rooms.push_back(Zone{ x + 1, r.y0, r.x1, r.y1 });
+            } else {
+                int y = r.y0 + ROOM_MIN_SIDE + rng.below(h - 2 * ROOM_MIN_SIDE);
+                for (int x = r.x0; x <= r.x1; x++) setWall(x, y);
+                int door = r.x0 + rng.below(std::max(1, w - DOOR_WIDTH + 1));
+                for (int x = door; x < door + DOOR_WIDTH && x <= r.x1; x++) clearWall(x, y);
+                rooms.push_back(Zone{ r.x0, r.y0, r.x1, y - 1 });
+                rooms.push_back(Zone{ r.x0, y + 1, r.x1, r.y1 });
+            }
+        }
+    }
+
+    // Kruskal's maze on a lattice of MAZE_PITCH cells: every wall line is
+    // drawn, then openings are cut in shuffled order wherever they join two
+    // parts of the maze not yet joined (and now and then where they don't)
+    template <class Rng>
+    void drawMaze(Rng& rng) {
+        int nx = std::max(1, (width + 1) / MAZE_PITCH), ny = std::max(1, (height + 1) / MAZE_PITCH);
+        for (int i = 0; i + 1 < nx; i++) {
+            for (int y = 0; y < height; y++) setWall(i * MAZE_PITCH + MAZE_PITCH - 1, y);
+        }
+        for (int j = 0; j + 1 < ny; j++) {
+            for (int x = 0; x < width; x++) setWall(x, j * MAZE_PITCH + MAZE_PITCH - 1);
+        }
+
+        // Edge e joins node e/2 to its right (even e) or lower (odd e) neighbour
+        edges.clear();
+        for (int j = 0; j < ny; j++) {
+            for (int i = 0; i < nx; i++) {
+                uint32_t node = j * nx + i;
+                if (i + 1 < nx) edges.push_back(node * 2);
+                if (j + 1 < ny) edges.push_back(node * 2 + 1);
+            }
+        }
+        for (size_t k = edges.size(); k > 1; k--) std::swap(edges[k - 1], edges[rng.below(k)]);
+
+        sets.reset((size_t)nx * ny);
+        for (uint32_t e : edges) {
+            uint32_t node = e / 2;
+            int i = node % nx, j = node / nx;
+            uint32_t other = e & 1 ? node + nx : node + 1;
+            if (!sets.unite(node, other) && rng.below(100) >= MAZE_LOOP_PERCENT) continue;
+            if (e & 1) {
+                int y = j * MAZE_PITCH + MAZE_PITCH - 1;
+                int x1 = i + 1 < nx ? i * MAZE_PITCH + MAZE_PITCH - 2 : width - 1;
+                for (int x = i * MAZE_PITCH; x <= x1; x++) clearWall(x, y);
+            } else {
+                int x = i * MAZE_PITCH + MAZE_PITCH - 1;
+                int y1 = j + 1 < ny ? j * MAZE_PITCH + MAZE_PITCH - 2 : height - 1;
+                for (int y = j * MAZE_PITCH; y <= y1; y++) clearWall(x, y);
+            }
+        }
+    }
+
+    // Joins neighbouring free cells (across the edges too when wrapping) and
+    // keeps the region holding the start zones, or the largest one when there
+    // are none. Returns the number of stranded cells walled up, or -1 if the
+    // layout splits the zones or strands too much and should be redrawn.
+    int settle(bool lastChance) {
+        size_t cells = (size_t)width * height;
+        sets.reset(cells);
+        size_t free = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (isWall(x, y)) continue;
+                free++;
+                uint32_t i = (uint32_t)y * width + x;
+                if (x + 1 < width && !isWall(x + 1, y)) sets.unite(i, i + 1);
+                if (y + 1 < height && !isWall(x, y + 1)) sets.unite(i, i + width);
+            }
+        }
+        if (wrapAround) {
+            for (int y = 0; y < height; y++) {
+                if (!isWall(0, y) && !isWall(width - 1, y)) sets.unite((uint32_t)y * width, (uint32_t)y * width + width - 1);
+            }
+            for (int x = 0; x < width; x++) {
+                if (!isWall(x, 0) && !isWall(x, height - 1)) sets.unite(x, (uint32_t)(height - 1) * width + x);
+            }
+        }
+        if (free == 0) return lastChance ? 0 : -1;
+
+        uint32_t keep = 0;
+        if (!zones.empty()) {
+            keep = sets.find((uint32_t)zones[0].y0 * width + zones[0].x0);
+            for (const Zone& z : zones) {
+                if (sets.find((uint32_t)z.y0 * width + z.x0) != keep) return -1;
+            }
+        } else {
+            counts.assign(cells, 0);
+            uint32_t largest = 0;
+            for (uint32_t i = 0; i < cells; i++) {
+                if (isWall(i % width, i / width)) continue;
+                uint32_t root = sets.find(i);
+                if (++counts[root] > largest) {
+                    largest = counts[root];
+                    keep = root;
+                }
+            }
+        }
+
+        size_t reachable = 0;
+        for (uint32_t i = 0; i < cells; i++) {
+            if (!isWall(i % width, i / width) && sets.find(i) == keep) reachable++;
+        }
+        if (reachable * 100 < free * MIN_REACHABLE_PERCENT && !lastChance) return -1;
+        for (uint32_t i = 0; i < cells; i++) {
+            if (!isWall(i % width, i / width) && sets.find(i) != keep) setWall(i % width, i / width);
+        }
+        return free - reachable;
+    }
+};
+
+#endif
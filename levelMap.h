@@ -0,0 +1,159 @@
+#ifndef LEVEL_MAP_H
+#define LEVEL_MAP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "levelGenerator.h"
+
+// Hand-made boards, compiled from text by levelCompiler (which describes the
+// text format) into a fixed binary layout that is mapped, not parsed:
+//   header
+//   starts      MapStart[startCount], player one's first
+//   fruit runs  FruitRun[runCount], the fruit spawn zones as row runs
+//   walls       wordsPerRow 64-bit words per row, bit x of a row is cell x
+// The wall rows are in the same shape as the game's occupancy grid, whose
+// chunks are 64 cells wide, so loading copies whole words into it.
+
+const uint32_t LEVEL_MAP_MAGIC = 0x534e4b4d; // "SNKM"
+const uint32_t LEVEL_MAP_VERSION = 1;
+
+struct LevelMapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;    // sizeof(LevelMapHeader) when written
+    int32_t width, height;
+    uint32_t wordsPerRow;
+    uint32_t startCount;
+    uint32_t runCount;
+    uint64_t zoneCells;     // cells in all fruit runs; 0 = fruits anywhere
+    uint8_t wrapAround;
+    uint8_t pad[7];
+};
+
+// A snake's head; it faces right with its body trailing left
+struct MapStart {
+    int32_t x, y;
+};
+
+// length cells from (x, y) rightwards; before counts the cells of the runs
+// ahead of it, so a uniform pick is a binary search
+struct FruitRun {
+    int32_t x, y;
+    uint32_t length;
+    uint32_t before;
+};
+
+static_assert(sizeof(LevelMapHeader) == 48 && sizeof(MapStart) == 8 && sizeof(FruitRun) == 16,
+              "the map layout must not depend on the compiler");
+
+class LevelMap {
+public:
+    LevelMap() : data(nullptr), mapped(0), header(nullptr), starts(nullptr), runs(nullptr), walls(nullptr) {}
+    ~LevelMap() { close(); }
+
+    LevelMap(const LevelMap&) = delete;
+    LevelMap& operator=(const LevelMap&) = delete;
+
+    // Maps a compiled map; false (and a message) if it can't be read or any
+    // section is out of bounds
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            perror(path.c_str());
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(LevelMapHeader)) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                data = (const char*)p;
+                mapped = st.st_size;
+            }
+        }
+        ::close(fd);
+        if (!data) {
+            perror(path.c_str());
+            return false;
+        }
+        if (!check()) {
+            fprintf(stderr, "%s: not a compiled level map of this version\n", path.c_str());
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data) munmap((void*)data, mapped);
+        data = nullptr;
+        mapped = 0;
+        header = nullptr;
+    }
+
+    bool isOpen() const { return header != nullptr; }
+
+    int getWidth() const { return header->width; }
+    int getHeight() const { return header->height; }
+    bool wrapAround() const { return header->wrapAround; }
+    int wordsPerRow() const { return header->wordsPerRow; }
+    int startCount() const { return header->startCount; }
+    MapStart start(int i) const { return starts[i]; }
+    const uint64_t* wallRows() const { return walls; }
+    bool isWall(int x, int y) const { return (walls[(size_t)y * header->wordsPerRow + (x >> 6)] >> (x & 63)) & 1; }
+
+    bool hasFruitZones() const { return header->zoneCells > 0; }
+    uint64_t zoneSize() const { return header->zoneCells; }
+
+    // Cell number `pick` (taken modulo the zone size) of the fruit zones
+    void zoneCell(uint64_t pick, int& x, int& y) const {
+        uint32_t k = pick % header->zoneCells;
+        const FruitRun* run = std::upper_bound(runs, runs + header->runCount, k,
+                                               [](uint32_t v, const FruitRun& r) { return v < r.before; }) - 1;
+        x = run->x + (k - run->before);
+        y = run->y;
+    }
+
+private:
+    const char* data;
+    size_t mapped;
+    const LevelMapHeader* header;
+    const MapStart* starts;
+    const FruitRun* runs;
+    const uint64_t* walls;
+
+    bool check() {
+        const LevelMapHeader* h = (const LevelMapHeader*)data;
+        if (h->magic != LEVEL_MAP_MAGIC || h->version != LEVEL_MAP_VERSION || h->headerSize != sizeof(LevelMapHeader)) return false;
+        if (h->width < 5 || h->height < 1 || (long long)h->width * h->height > MAX_LEVEL_CELLS) return false;
+        if (h->wordsPerRow != (uint32_t)(h->width + 63) / 64 || h->zoneCells > UINT32_MAX) return false;
+        uint64_t size = sizeof(LevelMapHeader) + (uint64_t)h->startCount * sizeof(MapStart) + (uint64_t)h->runCount * sizeof(FruitRun) +
+                        (uint64_t)h->wordsPerRow * h->height * sizeof(uint64_t);
+        if (size != mapped) return false;
+        const MapStart* s = (const MapStart*)(data + sizeof(LevelMapHeader));
+        const FruitRun* r = (const FruitRun*)(s + h->startCount);
+        for (uint32_t i = 0; i < h->startCount; i++) {
+            if (s[i].x < 2 || s[i].x >= h->width || s[i].y < 0 || s[i].y >= h->height) return false;
+        }
+        uint64_t cells = 0;
+        for (uint32_t i = 0; i < h->runCount; i++) {
+            if (r[i].before != cells || r[i].length == 0 || r[i].x < 0 || r[i].y < 0 || r[i].y >= h->height ||
+                (uint64_t)r[i].x + r[i].length > (uint64_t)h->width) return false;
+            cells += r[i].length;
+        }
+        if (cells != h->zoneCells) return false;
+        header = h;
+        starts = s;
+        runs = r;
+        walls = (const uint64_t*)(r + h->runCount);
+        return true;
+    }
+};
+
+#endif
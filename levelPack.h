@@ -0,0 +1,191 @@
+#ifndef LEVEL_PACK_H
+#define LEVEL_PACK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "levelGenerator.h"
+
+// Pre-generated levels for one board size, written by levelPacker and mapped
+// read-only by the game and the server. After a header, every level is one
+// fixed-size record (its metrics, then its wall bitboard, one row of 64-bit
+// words per board row), so level i sits at a computed offset: opening a pack
+// reads no level at all, and a random pick touches one record's pages.
+// Every level keeps the starts of 1..maxSnakes snakes clear and all of its
+// free cells reachable from them.
+
+const uint32_t LEVEL_PACK_MAGIC = 0x534e4b50; // "SNKP"
+const uint32_t LEVEL_PACK_VERSION = 1;
+
+struct LevelPackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;    // sizeof(LevelPackHeader) when written
+    uint32_t entrySize;     // sizeof(LevelEntry) + the bitboard
+    uint64_t levelCount;
+    int32_t width, height;
+    uint32_t wordsPerRow;
+    uint8_t wrapAround;     // levels checked with wrapping edges; they may need them
+    uint8_t maxSnakes;
+    uint8_t pad[2];
+    uint64_t seed;          // what levelPacker was run with
+};
+
+// What levelPacker measured; packs are sorted by difficulty, hardest first
+struct LevelEntry {
+    uint64_t hash;          // of the bitboard; no two levels in a pack share one
+    uint32_t freeCells;     // all reachable
+    uint32_t walls;
+    uint32_t corridors;     // free cells with free neighbours on two opposite sides only
+    uint32_t deadEnds;      // free cells with a single free neighbour
+    uint32_t difficulty;    // corridors + 4 * dead ends
+    uint8_t style;          // LevelStyle
+    uint8_t pad[3];
+};
+
+static_assert(sizeof(LevelPackHeader) == 48 && sizeof(LevelEntry) == 32, "the pack layout must not depend on the compiler");
+
+// 64-bit FNV-1a style hash of a bitboard, a word at a time
+inline uint64_t hashLevel(const uint64_t* bits, size_t words) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < words; i++) {
+        h ^= bits[i];
+        h *= 0x100000001B3ULL;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+// Fills in the metrics of a generated level (all but style)
+inline void measureLevel(const LevelGenerator& level, bool wrapAround, LevelEntry& e) {
+    int width = level.getWidth(), height = level.getHeight();
+    auto open = [&](int x, int y) {
+        if (wrapAround) {
+            x = (x + width) % width;
+            y = (y + height) % height;
+        } else if (x < 0 || x >= width || y < 0 || y >= height) {
+            return false;
+        }
+        return !level.isWall(x, y);
+    };
+    e.freeCells = e.corridors = e.deadEnds = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (level.isWall(x, y)) continue;
+            e.freeCells++;
+            bool up = open(x, y - 1), down = open(x, y + 1), left = open(x - 1, y), right = open(x + 1, y);
+            int exits = up + down + left + right;
+            if (exits == 1) e.deadEnds++;
+            if (exits == 2 && up == down) e.corridors++;
+        }
+    }
+    e.walls = (uint32_t)width * height - e.freeCells;
+    e.difficulty = e.corridors + 4 * e.deadEnds;
+    e.hash = hashLevel(level.getBits().data(), level.getBits().size());
+}
+
+class LevelPack {
+public:
+    LevelPack() : data(nullptr), mapped(0), header(nullptr) {}
+    ~LevelPack() { close(); }
+
+    LevelPack(const LevelPack&) = delete;
+    LevelPack& operator=(const LevelPack&) = delete;
+
+    // Maps a pack; false (and perror) if it can't be read, or its header
+    // doesn't match its size
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            perror(path.c_str());
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(LevelPackHeader)) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                data = (const char*)p;
+                mapped = st.st_size;
+            }
+        }
+        ::close(fd);
+        if (!data) {
+            perror(path.c_str());
+            return false;
+        }
+        header = (const LevelPackHeader*)data;
+        const LevelPackHeader& h = *header;
+        bool valid = h.magic == LEVEL_PACK_MAGIC && h.version == LEVEL_PACK_VERSION && h.headerSize == sizeof(LevelPackHeader) &&
+                     h.width >= 5 && h.height >= 1 && (long long)h.width * h.height <= MAX_LEVEL_CELLS &&
+                     h.wordsPerRow == (uint32_t)(h.width + 63) / 64 &&
+                     h.entrySize == sizeof(LevelEntry) + (uint64_t)h.wordsPerRow * h.height * 8 && h.levelCount > 0 &&
+                     h.levelCount <= (mapped - sizeof(LevelPackHeader)) / h.entrySize &&
+                     mapped == sizeof(LevelPackHeader) + h.levelCount * h.entrySize;
+        if (!valid) {
+            fprintf(stderr, "%s: not a level pack of this version\n", path.c_str());
+            close();
+            return false;
+        }
+        madvise((void*)data, mapped, MADV_RANDOM); // picks are scattered; don't read ahead
+        return true;
+    }
+
+    void close() {
+        if (data) munmap((void*)data, mapped);
+        data = nullptr;
+        mapped = 0;
+        header = nullptr;
+    }
+
+    bool isOpen() const { return header != nullptr; }
+
+    // Whether levels from this pack are valid for a game with these settings
+    bool fits(int width, int height, int snakes, bool wrapAround) const {
+        return header && width == header->width && height == header->height && snakes <= header->maxSnakes &&
+               (wrapAround || !header->wrapAround);
+    }
+
+    size_t size() const { return header ? header->levelCount : 0; }
+    const LevelPackHeader& getHeader() const { return *header; }
+
+    const LevelEntry& entry(size_t i) const { return *(const LevelEntry*)record(i); }
+
+    // Level i's walls, in LevelGenerator::getBits() form
+    const uint64_t* wallRows(size_t i) const { return bitboard(i); }
+
+    bool isWall(size_t i, int x, int y) const {
+        return (bitboard(i)[(size_t)y * header->wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    // Calls fn(x, y) for every wall of level i, row by row
+    template <class Fn>
+    void forEachWall(size_t i, Fn fn) const {
+        const uint64_t* bits = bitboard(i);
+        for (int y = 0; y < header->height; y++) {
+            for (uint32_t w = 0; w < header->wordsPerRow; w++) {
+                uint64_t word = bits[(size_t)y * header->wordsPerRow + w];
+                while (word) {
+                    int bit = __builtin_ctzll(word);
+                    word &= word - 1;
+                    fn((int)(w << 6) + bit, y);
+                }
+            }
+        }
+    }
+
+private:
+    const char* data;
+    size_t mapped;
+    const LevelPackHeader* header;
+
+    const char* record(size_t i) const { return data + sizeof(LevelPackHeader) + i * header->entrySize; }
+    const uint64_t* bitboard(size_t i) const { return (const uint64_t*)(record(i) + sizeof(LevelEntry)); }
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include "snakeCore.h"
+
+using namespace std;
+
+// Builds a level pack (see levelPack.h). Levels are generated on every core,
+// measured, stripped of duplicates and sorted hardest first. Level i is drawn
+// from a generator seeded from (seed, i) and lands in slot i, so the same
+// arguments write the same pack whatever the thread count.
+
+const int LEVEL_BATCH = 64; // levels a thread claims at a time
+
+struct PackJob {
+    int width, height;
+    bool wrapAround;
+    int maxSnakes;
+    int style;              // a LevelStyle, or -1 to cycle through all of them
+    uint64_t seed;
+    size_t count;
+    size_t words;           // bitboard words per level
+    vector<LevelEntry> entries;
+    vector<uint64_t> bits;  // count * words
+    atomic<size_t> next{0};
+};
+
+void generateLevels(PackJob& job) {
+    LevelGenerator level;
+    while (true) {
+        size_t first = job.next.fetch_add(LEVEL_BATCH);
+        if (first >= job.count) return;
+        for (size_t i = first; i < min(job.count, first + LEVEL_BATCH); i++) {
+            GameRng seeder = { job.seed << 32 ^ i };
+            GameRng rng = { seeder.next() };
+            LevelStyle style = job.style < 0 ? (LevelStyle)(i % LEVEL_STYLE_COUNT) : (LevelStyle)job.style;
+            level.begin(job.width, job.height, job.wrapAround);
+            // Clear for every snake count the pack is good for
+            for (int n = 1; n <= job.maxSnakes; n++) {
+                for (int k = 0; k < n; k++) keepStartClear(level, startHead(job.width, job.height, n, k));
+            }
+            level.generate(style, 0, rng);
+            LevelEntry& e = job.entries[i];
+            memset(&e, 0, sizeof(e));
+            measureLevel(level, job.wrapAround, e);
+            e.style = style;
+            memcpy(&job.bits[i * job.words], level.getBits().data(), job.words * sizeof(uint64_t));
+        }
+    }
+}
+
+// Written next to the target and renamed over it once complete
+bool writePack(const string& path, const PackJob& job, const vector<uint32_t>& order) {
+    LevelPackHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = LEVEL_PACK_MAGIC;
+    h.version = LEVEL_PACK_VERSION;
+    h.headerSize = sizeof(LevelPackHeader);
+    h.entrySize = sizeof(LevelEntry) + job.words * sizeof(uint64_t);
+    h.levelCount = order.size();
+    h.width = job.width;
+    h.height = job.height;
+    h.wordsPerRow = (job.width + 63) / 64;
+    h.wrapAround = job.wrapAround;
+    h.maxSnakes = job.maxSnakes;
+    h.seed = job.seed;
+
+    string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(tmpPath.c_str());
+        return false;
+    }
+    string out((const char*)&h, sizeof(h));
+    bool ok = true;
+    for (size_t k = 0; k < order.size() && ok; k++) {
+        out.append((const char*)&job.entries[order[k]], sizeof(LevelEntry));
+        out.append((const char*)&job.bits[order[k] * job.words], job.words * sizeof(uint64_t));
+        if (out.size() >= (1 << 20) || k + 1 == order.size()) {
+            ok = write(fd, out.data(), out.size()) == (ssize_t)out.size();
+            out.clear();
+        }
+    }
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        perror(path.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Usage: levelPacker --out FILE [--board WxH] [--count N] [--keep N] [--style STYLE|all] [--snakes N] [--wrap] [--threads N] [--seed N]
+int main(int argc, char* argv[]) {
+    PackJob job;
+    job.width = WIDTH;
+    job.height = HEIGHT;
+    job.wrapAround = false;
+    job.maxSnakes = MAX_SNAKES;
+    job.style = -1;
+    job.seed = 1;
+    job.count = 10000;
+    size_t keep = 0;
+    int threadCount = 0;
+    string outPath;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (arg == "--board" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &job.width, &job.height) != 2 || job.width < 5 || job.height < 1 ||
+                (long long)job.width * job.height > MAX_LEVEL_CELLS) {
+                cerr << "--board expects WxH from 5x1 up to " << MAX_LEVEL_CELLS << " cells" << endl;
+                return 1;
+            }
+        } else if (arg == "--count" && i + 1 < argc) {
+            job.count = max(1LL, atoll(argv[++i]));
+        } else if (arg == "--keep" && i + 1 < argc) {
+            keep = max(1LL, atoll(argv[++i]));
+        } else if (arg == "--style" && i + 1 < argc) {
+            LevelStyle style;
+            string name = argv[++i];
+            if (name == "all") {
+                job.style = -1;
+            } else if (parseLevelStyle(name, style)) {
+                job.style = style;
+            } else {
+                cerr << "--style expects scatter, walls, rooms, maze or all" << endl;
+                return 1;
+            }
+        } else if (arg == "--snakes" && i + 1 < argc) {
+            job.maxSnakes = max(1, min(MAX_SNAKES, atoi(argv[++i])));
+        } else if (arg == "--wrap") {
+            job.wrapAround = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threadCount = max(1, atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            job.seed = strtoull(argv[++i], nullptr, 10);
+        } else {
+            outPath.clear();
+            break;
+        }
+    }
+    if (outPath.empty()) {
+        cerr << "Usage: " << argv[0] << " --out FILE [--board WxH] [--count N] [--keep N] [--style STYLE|all] [--snakes N] [--wrap] [--threads N] [--seed N]" << endl;
+        return 1;
+    }
+    job.maxSnakes = max(1, min(job.maxSnakes, job.height - 1));
+    if (threadCount == 0) threadCount = max(1u, std::thread::hardware_concurrency());
+    job.words = (size_t)(job.width + 63) / 64 * job.height;
+    job.entries.resize(job.count);
+    job.bits.resize(job.count * job.words);
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < threadCount; i++) threads.emplace_back(generateLevels, ref(job));
+    for (thread& t : threads) t.join();
+    double generated = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // First copy of each bitboard wins; equal hashes are compared in full
+    vector<uint32_t> order;
+    unordered_map<uint64_t, uint32_t> seen;
+    seen.reserve(job.count);
+    size_t duplicates = 0;
+    for (size_t i = 0; i < job.count; i++) {
+        auto found = seen.emplace(job.entries[i].hash, i);
+        if (!found.second && memcmp(&job.bits[found.first->second * job.words], &job.bits[i * job.words], job.words * sizeof(uint64_t)) == 0) {
+            duplicates++;
+            continue;
+        }
+        order.push_back(i);
+    }
+    stable_sort(order.begin(), order.end(), [&job](uint32_t a, uint32_t b) { return job.entries[a].difficulty > job.entries[b].difficulty; });
+    if (keep && order.size() > keep) order.resize(keep);
+
+    if (!writePack(outPath, job, order)) return 1;
+    const LevelEntry& hardest = job.entries[order.front()];
+    const LevelEntry& easiest = job.entries[order.back()];
+    printf("%zu levels in %.2fs on %d threads (%.0f levels/s), %zu duplicates, %zu written to %s\n", job.count, generated, threadCount,
+           job.count / generated, duplicates, order.size(), outPath.c_str());
+    printf("difficulty %u (%u corridor cells, %u dead ends) down to %u\n", hardest.difficulty, hardest.corridors, hardest.deadEnds, easiest.difficulty);
+    return 0;
+}
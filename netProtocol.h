@@ -0,0 +1,471 @@
+#ifndef NET_PROTOCOL_H
+#define NET_PROTOCOL_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "snakeCore.h"
+
+// Wire format shared by snakeServer and snakeClient. Every message is
+// [u32 length][u8 type][payload], little-endian, where length counts the type
+// byte and the payload. Coordinates go out as u16, so networked boards are
+// limited to 65535 cells a side. leaderboardServer speaks the same framing
+// over a Unix socket.
+
+const int DEFAULT_PORT = 7777;
+const uint32_t MAX_MESSAGE = 16 << 20;
+const uint8_t SPECTATOR_SLOT = 255; // WELCOME slot for a connection that only watches
+
+enum MessageType {
+    MSG_JOIN = 1,       // C->S  u8 nameLength, name: queue for the next free room seat
+    MSG_INPUT = 2,      // C->S  u8 direction, u32 sequence number (optional, acked in frames)
+    MSG_WATCH = 3,      // C->S  u32 room (0 = any): spectate; must be the last message sent
+    MSG_WELCOME = 10,   // S->C  u32 room, u8 slot, settings, names: the room has started
+    MSG_STATE = 11,     // S->C  keyframe: the full game state
+    MSG_GAME_OVER = 12, // S->C  u8 snakes, i32 score each
+    MSG_DELTA = 13,     // S->C  what changed since the previous STATE or DELTA
+    MSG_SUBMIT = 20,    // C->L  score key (str name, u32 width, u32 height, u8 flags), i32 score
+    MSG_STANDINGS_QUERY = 21, // C->L  score key: standings without submitting
+    MSG_STANDINGS = 30  // L->C  u8 improved, i64 rank, i64 players, u8 count, (str name, i32 score) each
+};
+
+// Appends messages to a byte buffer
+class MessageWriter {
+public:
+    explicit MessageWriter(std::string& out) : out(out), start(0) {}
+
+    void begin(MessageType type) {
+        start = out.size();
+        u32(0); // patched in end()
+        u8(type);
+    }
+
+    void end() {
+        uint32_t length = out.size() - start - 4;
+        memcpy(&out[start], &length, 4);
+    }
+
+    void u8(uint8_t v) { out.push_back((char)v); }
+    void u16(uint16_t v) { out.append((const char*)&v, 2); }
+    void u32(uint32_t v) { out.append((const char*)&v, 4); }
+    void i32(int32_t v) { out.append((const char*)&v, 4); }
+    void i64(int64_t v) { out.append((const char*)&v, 8); }
+    // LEB128: 7 bits per byte, so small numbers take one byte
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back((char)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((char)v);
+    }
+    void str(const std::string& s) {
+        uint8_t n = s.size() > 255 ? 255 : s.size();
+        u8(n);
+        out.append(s.data(), n);
+    }
+
+private:
+    std::string& out;
+    size_t start;
+};
+
+// Reads one message payload; every read is bounds-checked and a short
+// message just leaves ok false instead of reading past the end
+class MessageReader {
+public:
+    MessageReader(const char* data, size_t size) : p((const uint8_t*)data), end((const uint8_t*)data + size), ok(true) {}
+
+    uint8_t u8() { uint8_t v = 0; take(&v, 1); return v; }
+    uint16_t u16() { uint16_t v = 0; take(&v, 2); return v; }
+    uint32_t u32() { uint32_t v = 0; take(&v, 4); return v; }
+    int32_t i32() { int32_t v = 0; take(&v, 4); return v; }
+    int64_t i64() { int64_t v = 0; take(&v, 8); return v; }
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = u8();
+            if (!ok) return 0;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+    std::string str() {
+        uint8_t n = u8();
+        if (!ok || (size_t)(end - p) < n) {
+            ok = false;
+            return std::string();
+        }
+        std::string s((const char*)p, n);
+        p += n;
+        return s;
+    }
+
+    size_t remaining() const { return end - p; }
+    bool good() const { return ok; }
+    void fail() { ok = false; }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok;
+
+    void take(void* dst, size_t n) {
+        if (!ok || (size_t)(end - p) < n) {
+            ok = false;
+            return;
+        }
+        memcpy(dst, p, n);
+        p += n;
+    }
+};
+
+// Splits complete messages off the front of a receive buffer. Returns false
+// when more bytes are needed; a length over MAX_MESSAGE sets bad.
+inline bool nextMessage(const std::string& buf, size_t& pos, uint8_t& type, const char*& payload, size_t& size, bool& bad) {
+    if (buf.size() - pos < 4) return false;
+    uint32_t length;
+    memcpy(&length, buf.data() + pos, 4);
+    if (length == 0 || length > MAX_MESSAGE) {
+        bad = true;
+        return false;
+    }
+    if (buf.size() - pos - 4 < length) return false;
+    type = (uint8_t)buf[pos + 4];
+    payload = buf.data() + pos + 5;
+    size = length - 1;
+    pos += 4 + length;
+    return true;
+}
+
+inline void writeSettings(MessageWriter& w, const GameSettings& s) {
+    w.u16(s.width);
+    w.u16(s.height);
+    w.u8(s.wrapAround);
+    w.u8(s.snakes);
+    w.u8(s.humans);
+    w.u8(s.powerUps);
+    w.u32(s.fruitLifetime);
+}
+
+inline GameSettings readSettings(MessageReader& r) {
+    GameSettings s;
+    s.width = r.u16();
+    s.height = r.u16();
+    s.wrapAround = r.u8();
+    s.snakes = r.u8();
+    s.humans = r.u8();
+    s.powerUps = r.u8();
+    s.fruitLifetime = r.u32();
+    if (s.fruitLifetime < 0) r.fail();
+    if (s.width < 5 || s.height < 1 || s.snakes < 1 || s.snakes > MAX_SNAKES || s.humans > s.snakes) r.fail();
+    return s;
+}
+
+// The highest input sequence number a player's snake has had applied, so a
+// predicting client knows which of its own turns the server has seen
+struct InputAck {
+    uint8_t slot;
+    uint32_t seq;
+};
+
+inline void writeAcks(MessageWriter& w, const std::vector<InputAck>& acks) {
+    w.varint(acks.size());
+    for (const InputAck& a : acks) {
+        w.u8(a.slot);
+        w.varint(a.seq);
+    }
+}
+
+inline void readAcks(MessageReader& r, std::vector<InputAck>* acks) {
+    uint64_t count = r.varint();
+    for (uint64_t i = 0; i < count && r.good(); i++) {
+        InputAck a;
+        a.slot = r.u8();
+        a.seq = (uint32_t)r.varint();
+        if (acks && r.good()) acks->push_back(a);
+    }
+}
+
+// The whole game: clock, generator, snakes with their timing and effects,
+// fruits with their expiry, obstacles, hazards, portals, then input acks. Enough to simulate on from, not just to draw.
+inline void writeState(std::string& out, const GameCore& core, const std::vector<InputAck>& acks = std::vector<InputAck>()) {
+    GameSnapshot snap;
+    core.snapshot(snap);
+    MessageWriter w(out);
+    w.begin(MSG_STATE);
+    w.i64(snap.clock);
+    w.i64(snap.rng.state);
+    w.u8(snap.started);
+    w.u8(snap.snakes.size());
+    for (const Snake& s : snap.snakes) {
+        w.u8(s.alive);
+        w.u8(s.bot);
+        w.u8(s.dir);
+        w.i32(s.score);
+        w.i32(s.speed);
+        w.i64(s.nextMoveAt);
+        w.i32(s.fruitsEaten);
+        for (long long end : s.effectEnds) w.varint(end);
+        w.u32(s.body.size());
+        for (const Cell& c : s.body) {
+            w.u16(c.x);
+            w.u16(c.y);
+        }
+    }
+    const FruitIndex& fruits = snap.fruits;
+    w.u32(fruits.size());
+    for (size_t i = 0; i < fruits.size(); i++) {
+        w.u16(fruits[i].x);
+        w.u16(fruits[i].y);
+        w.u8(fruits[i].type);
+        w.varint(fruits[i].expiresAt);
+    }
+    size_t countAt = out.size();
+    w.u32(0);
+    uint32_t obstacles = 0;
+    core.forEachObstacle([&](int x, int y) {
+        w.u16(x);
+        w.u16(y);
+        obstacles++;
+    });
+    memcpy(&out[countAt], &obstacles, 4);
+    const BoardEntities& entities = snap.entities;
+    w.varint(entities.movedTick);
+    w.u32(entities.motion.size());
+    for (size_t i = 0; i < entities.motion.size(); i++) {
+        const Cell& c = entities.position.get(entities.motion.owner(i));
+        const Motion& m = entities.motion[i];
+        w.u16(c.x);
+        w.u16(c.y);
+        w.u8(m.dx);
+        w.u8(m.dy);
+        w.u8(m.heading);
+        w.u16(m.patrolLength);
+        w.u16(m.patrolAt);
+    }
+    w.u32(entities.exit.size());
+    for (size_t i = 0; i < entities.exit.size(); i++) {
+        const Cell& c = entities.position.get(entities.exit.owner(i));
+        w.u16(c.x);
+        w.u16(c.y);
+        w.u16(entities.exit[i].x);
+        w.u16(entities.exit[i].y);
+    }
+    writeAcks(w, acks);
+    w.end();
+}
+
+// Rebuilds a replica GameCore from a MSG_STATE payload
+inline bool readState(MessageReader& r, GameCore& core, const GameSettings& settings, std::vector<InputAck>* acks = nullptr) {
+    core.clearBoard(settings);
+    GameSnapshot snap;
+    snap.clock = r.i64();
+    snap.rng.state = r.i64();
+    snap.started = r.u8();
+    int snakes = r.u8();
+    if (snakes != settings.snakes) r.fail();
+    for (int i = 0; i < snakes && r.good(); i++) {
+        Snake s;
+        s.alive = r.u8();
+        s.bot = r.u8();
+        int dir = r.u8();
+        s.dir = dir <= RIGHT ? (Direction)dir : STOP;
+        s.score = r.i32();
+        s.speed = r.i32();
+        s.nextMoveAt = r.i64();
+        s.fruitsEaten = r.i32();
+        for (long long& end : s.effectEnds) end = (long long)(r.varint() & INT64_MAX);
+        uint32_t length = r.u32();
+        for (uint32_t k = 0; k < length && r.good(); k++) {
+            Cell c;
+            c.x = r.u16();
+            c.y = r.u16();
+            if (c.x >= settings.width || c.y >= settings.height) r.fail();
+            s.body.push_back(c);
+        }
+        if ((s.alive && s.body.empty()) || dir > RIGHT || s.speed <= 0) r.fail();
+        snap.snakes.push_back(s);
+    }
+    uint32_t fruits = r.u32();
+    snap.fruits.reset(settings.width, settings.height, std::max(1, (int)std::min(fruits, 1u << 20)));
+    for (uint32_t i = 0; i < fruits && r.good(); i++) {
+        Fruit f;
+        f.x = r.u16();
+        f.y = r.u16();
+        int type = r.u8();
+        f.type = type < FRUIT_TYPE_COUNT ? (FruitType)type : NORMAL;
+        f.expiresAt = (long long)(r.varint() & INT64_MAX);
+        if (r.good() && f.x < settings.width && f.y < settings.height && !snap.fruits.find(f.x, f.y)) snap.fruits.insert(f);
+    }
+    uint32_t obstacles = r.u32();
+    for (uint32_t i = 0; i < obstacles && r.good(); i++) {
+        int x = r.u16();
+        int y = r.u16();
+        if (r.good() && x < settings.width && y < settings.height) core.placeObstacle(x, y);
+    }
+    snap.entities.movedTick = (long long)(r.varint() & INT64_MAX);
+    uint32_t hazards = r.u32();
+    for (uint32_t i = 0; i < hazards && r.good(); i++) {
+        Cell c;
+        c.x = r.u16();
+        c.y = r.u16();
+        Motion m = {};
+        m.dx = (int8_t)r.u8();
+        m.dy = (int8_t)r.u8();
+        m.heading = (int8_t)r.u8();
+        m.patrolLength = r.u16();
+        m.patrolAt = r.u16();
+        if (c.x >= settings.width || c.y >= settings.height || m.dx < -1 || m.dx > 1 || m.dy < -1 || m.dy > 1 ||
+            m.heading < -1 || m.heading > 1 || m.patrolAt > m.patrolLength) r.fail();
+        if (!r.good()) break;
+        Entity e = snap.entities.pool.create();
+        snap.entities.position.add(e, c);
+        snap.entities.motion.add(e, m);
+    }
+    uint32_t portals = r.u32();
+    for (uint32_t i = 0; i < portals && r.good(); i++) {
+        Cell c, to;
+        c.x = r.u16();
+        c.y = r.u16();
+        to.x = r.u16();
+        to.y = r.u16();
+        if (c.x >= settings.width || c.y >= settings.height || to.x >= settings.width || to.y >= settings.height) r.fail();
+        if (!r.good()) break;
+        Entity e = snap.entities.pool.create();
+        snap.entities.position.add(e, c);
+        snap.entities.exit.add(e, to);
+    }
+    readAcks(r, acks);
+    if (r.good()) core.restore(snap);
+    return r.good();
+}
+
+// Delta entries pack a kind, a snake and a 2-bit argument (direction or
+// fruit type) into one byte, so a snake's step costs a single byte on the
+// wire. Fruit types from WIRE_TYPE_ESCAPE on don't fit and follow as a
+// varint. Phase starts need no payload: the replica knows when the next one is.
+static_assert(MAX_SNAKES <= 8, "delta entries keep the snake index in 3 bits");
+
+enum WireChange { WIRE_MOVED, WIRE_GREW, WIRE_DIED, WIRE_SCORED, WIRE_FRUIT_ADDED, WIRE_FRUIT_REMOVED, WIRE_STEERED, WIRE_SYNC };
+enum WireSync { SYNC_PHASE, SYNC_RNG };
+const int WIRE_TYPE_ESCAPE = 3;
+
+inline uint8_t changeHeader(WireChange kind, int snake, int arg) {
+    return (uint8_t)(kind << 5 | snake << 2 | arg);
+}
+
+// The journal since the last frame: varint count, one header byte per change
+// plus a varint score, varint x, y (and expiry, for added fruit) or raw u64
+// generator state where needed, then the input acks
+inline void writeDelta(std::string& out, const std::vector<BoardChange>& changes, const std::vector<InputAck>& acks = std::vector<InputAck>()) {
+    MessageWriter w(out);
+    w.begin(MSG_DELTA);
+    w.varint(changes.size());
+    for (const BoardChange& c : changes) {
+        switch (c.kind) {
+            case SNAKE_MOVED:
+                w.u8(changeHeader(WIRE_MOVED, c.snake, c.dir - UP));
+                break;
+            case SNAKE_GREW:
+                w.u8(changeHeader(WIRE_GREW, c.snake, c.dir - UP));
+                break;
+            case SNAKE_STEERED:
+                w.u8(changeHeader(WIRE_STEERED, c.snake, c.dir - UP));
+                break;
+            case SNAKE_DIED:
+                w.u8(changeHeader(WIRE_DIED, c.snake, 0));
+                break;
+            case SNAKE_SCORED:
+                w.u8(changeHeader(WIRE_SCORED, c.snake, 0));
+                w.varint(c.score);
+                break;
+            case FRUIT_ADDED:
+            case FRUIT_REMOVED:
+                w.u8(changeHeader(c.kind == FRUIT_ADDED ? WIRE_FRUIT_ADDED : WIRE_FRUIT_REMOVED, 0,
+                                  std::min((int)c.fruit.type, WIRE_TYPE_ESCAPE)));
+                if (c.fruit.type >= WIRE_TYPE_ESCAPE) w.varint(c.fruit.type);
+                w.varint(c.fruit.x);
+                w.varint(c.fruit.y);
+                if (c.kind == FRUIT_ADDED) w.varint(c.fruit.expiresAt);
+                break;
+            case PHASE_STARTED:
+                w.u8(changeHeader(WIRE_SYNC, 0, SYNC_PHASE));
+                break;
+            case RNG_ADVANCED:
+                w.u8(changeHeader(WIRE_SYNC, 0, SYNC_RNG));
+                w.i64(c.rng);
+                break;
+        }
+    }
+    writeAcks(w, acks);
+    w.end();
+}
+
+// Applies a MSG_DELTA to a replica built from an earlier keyframe. Anything
+// that doesn't fit the replica (unknown snake, fruit off the board) fails the
+// frame; the caller should wait for the next keyframe.
+inline bool readDelta(MessageReader& r, GameCore& core, std::vector<InputAck>* acks = nullptr) {
+    uint64_t count = r.varint();
+    int snakes = core.getSnakes().size();
+    for (uint64_t i = 0; i < count && r.good(); i++) {
+        uint8_t header = r.u8();
+        int kind = header >> 5, snake = (header >> 2) & 7, arg = header & 3;
+        if (!r.good()) break;
+        if ((kind <= WIRE_SCORED || kind == WIRE_STEERED) && snake >= snakes) {
+            r.fail();
+            break;
+        }
+        switch (kind) {
+            case WIRE_MOVED:
+            case WIRE_GREW:
+                if (!core.moveSnake(snake, (Direction)(UP + arg), kind == WIRE_GREW)) r.fail();
+                break;
+            case WIRE_STEERED:
+                core.steer(snake, (Direction)(UP + arg));
+                break;
+            case WIRE_DIED:
+                core.killSnake(snake);
+                break;
+            case WIRE_SCORED:
+                core.setScore(snake, (int)r.varint());
+                break;
+            case WIRE_FRUIT_ADDED:
+            case WIRE_FRUIT_REMOVED: {
+                uint64_t type = arg == WIRE_TYPE_ESCAPE ? r.varint() : arg;
+                uint64_t x = r.varint(), y = r.varint();
+                long long expiresAt = kind == WIRE_FRUIT_ADDED ? (long long)(r.varint() & INT64_MAX) : 0;
+                if (!r.good() || x >= (uint64_t)core.getWidth() || y >= (uint64_t)core.getHeight()) {
+                    r.fail();
+                    break;
+                }
+                if (kind == WIRE_FRUIT_REMOVED) {
+                    if (core.isFruit(x, y)) core.takeFruit(x, y);
+                } else if (!core.isFruit(x, y)) {
+                    Fruit f;
+                    f.x = x;
+                    f.y = y;
+                    f.type = type < FRUIT_TYPE_COUNT ? (FruitType)type : NORMAL;
+                    f.expiresAt = expiresAt;
+                    core.placeFruit(f);
+                }
+                break;
+            }
+            case WIRE_SYNC:
+                if (arg == SYNC_PHASE) {
+                    if (!core.beginPhase()) r.fail();
+                } else if (arg == SYNC_RNG) {
+                    core.setRngState(r.i64());
+                } else {
+                    r.fail();
+                }
+                break;
+        }
+    }
+    readAcks(r, acks);
+    return r.good();
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef PREDICTOR_H
+#define PREDICTOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "snakeCore.h"
+#include "netProtocol.h"
+
+// Client-side prediction with rollback. The client keeps two games: the
+// confirmed one, rebuilt exactly from server frames, and a predicted one it
+// runs ahead with the same deterministic core so the player's own turns show
+// up at once instead of a round trip later. Every predicted phase leaves a
+// fingerprint in a bounded ring; when the server confirms a phase the two are
+// compared, and only a mismatch rolls the prediction back to the confirmed
+// state and re-simulates it with the turns the server hasn't seen yet.
+
+const int PREDICTION_HISTORY = 64; // phases the prediction may run ahead of the server
+
+struct RollbackStats {
+    long long confirmed;      // server phases that matched the prediction
+    long long rollbacks;      // mismatches that had to be re-simulated
+    long long phasesReplayed;
+    long long totalMicros;    // time spent restoring and re-simulating
+    long long maxMicros;
+};
+
+class Predictor {
+public:
+    Predictor() : slot(0), nextSeq(1), lead(0), confirmedClock(0), confirmedAt(0), historyStart(0), historyCount(0), nextPending(0) {
+        stats = RollbackStats();
+    }
+
+    // A keyframe arrived: start over from it, keeping turns it hasn't acked
+    void resync(const GameCore& confirmed, int playerSlot, const std::vector<InputAck>& acks, long long now) {
+        slot = playerSlot;
+        predicted.clearBoard(confirmed.getSettings());
+        confirmed.forEachObstacle([this](int x, int y) { predicted.placeObstacle(x, y); });
+        confirmed.snapshot(scratch);
+        predicted.restore(scratch);
+        dropAcked(acks, now);
+        markConfirmed(confirmed, now);
+        historyCount = 0;
+        nextPending = 0;
+        advance(now);
+    }
+
+    // A delta has been applied to the confirmed game
+    void confirm(const GameCore& confirmed, const std::vector<InputAck>& acks, long long now) {
+        dropAcked(acks, now);
+        markConfirmed(confirmed, now);
+        long long clock = confirmed.getClock();
+
+        // Still behind the server (a frame beat our own timer): take its state as is
+        if (predicted.getClock() < clock) {
+            adopt(confirmed);
+            advance(now);
+            return;
+        }
+        while (historyCount > 0 && history[historyStart].clock < clock) popHistory();
+        if (historyCount > 0 && history[historyStart].clock == clock && history[historyStart].fingerprint == confirmed.fingerprint()) {
+            popHistory();
+            stats.confirmed++;
+            return;
+        }
+
+        long long start = wallMicros();
+        adopt(confirmed);
+        stats.phasesReplayed += advance(now);
+        long long took = wallMicros() - start;
+        stats.rollbacks++;
+        stats.totalMicros += took;
+        if (took > stats.maxMicros) stats.maxMicros = took;
+    }
+
+    // Applies one of our turns to the prediction; returns its sequence
+    // number for the MSG_INPUT that carries it to the server
+    uint32_t steer(Direction d, long long now) {
+        PendingInput input = { nextSeq++, d, predicted.getClock(), now };
+        pending.push_back(input);
+        predicted.steer(slot, d);
+        nextPending = pending.size();
+        return input.seq;
+    }
+
+    // Runs the prediction up to where the server will be when an input sent
+    // now reaches it; returns the number of phases stepped
+    int advance(long long now) {
+        long long target = confirmedClock + (now - confirmedAt) + lead;
+        int stepped = 0;
+        while (historyCount < PREDICTION_HISTORY && !predicted.isOver()) {
+            long long due = predicted.nextMoveTime();
+            if (due < 0 || due > target) break;
+            applyPending(due);
+            predicted.stepPhase();
+            pushHistory(predicted.getClock(), predicted.fingerprint());
+            stepped++;
+        }
+        applyPending(predicted.getClock());
+        return stepped;
+    }
+
+    // Wall time the next predicted phase is due, or -1 when there is nothing
+    // to step until the server catches up
+    long long nextPhaseAt() const {
+        long long due = predicted.nextMoveTime();
+        if (due < 0 || historyCount >= PREDICTION_HISTORY || predicted.isOver()) return -1;
+        return confirmedAt + (due - confirmedClock) - lead;
+    }
+
+    const GameCore& view() const { return predicted; }
+    const RollbackStats& getStats() const { return stats; }
+    long long roundTrip() const { return lead; }
+
+private:
+    struct PendingInput {
+        uint32_t seq;
+        Direction dir;
+        long long clock;   // predicted game clock it was applied at
+        long long sentAt;  // wall clock, for the round-trip estimate
+    };
+    struct PhaseRecord {
+        long long clock;
+        uint64_t fingerprint;
+    };
+
+    GameCore predicted;
+    GameSnapshot scratch;  // reused so a rollback doesn't allocate once warmed up
+    int slot;
+    uint32_t nextSeq;
+    long long lead;        // smoothed round trip in microseconds
+    long long confirmedClock, confirmedAt;
+    PhaseRecord history[PREDICTION_HISTORY];
+    int historyStart, historyCount;
+    std::deque<PendingInput> pending; // sent but not acked yet, oldest first
+    size_t nextPending;    // first pending input not applied to the prediction
+    RollbackStats stats;
+
+    static long long wallMicros() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void markConfirmed(const GameCore& confirmed, long long now) {
+        confirmedClock = confirmed.getClock();
+        confirmedAt = now;
+    }
+
+    // Back to the confirmed state; turns the server hasn't applied go in
+    // again as the re-simulation reaches the clock they were made at
+    void adopt(const GameCore& confirmed) {
+        confirmed.snapshot(scratch);
+        predicted.restore(scratch);
+        historyCount = 0;
+        nextPending = 0;
+        applyPending(predicted.getClock());
+    }
+
+    void applyPending(long long upTo) {
+        while (nextPending < pending.size() && pending[nextPending].clock <= upTo) {
+            predicted.steer(slot, pending[nextPending].dir);
+            nextPending++;
+        }
+    }
+
+    void dropAcked(const std::vector<InputAck>& acks, long long now) {
+        for (const InputAck& a : acks) {
+            if (a.slot != slot) continue;
+            while (!pending.empty() && pending.front().seq <= a.seq) {
+                if (pending.front().seq == a.seq) {
+                    long long sample = now - pending.front().sentAt;
+                    lead = lead ? (lead * 7 + sample) / 8 : sample;
+                }
+                pending.pop_front();
+                if (nextPending > 0) nextPending--;
+            }
+        }
+    }
+
+    void pushHistory(long long clock, uint64_t fingerprint) {
+        PhaseRecord& r = history[(historyStart + historyCount) % PREDICTION_HISTORY];
+        r.clock = clock;
+        r.fingerprint = fingerprint;
+        historyCount++;
+    }
+
+    void popHistory() {
+        historyStart = (historyStart + 1) % PREDICTION_HISTORY;
+        historyCount--;
+    }
+};
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef SCORE_STORE_H
+#define SCORE_STORE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snakeCore.h"
+
+// Best score per player name and game settings, kept on disk in two files:
+//   PATH.log  fixed-size records appended with O_APPEND; every game that
+//             beats a best adds one, so a crash loses at most that game
+//   PATH.tbl  the log folded into a table sorted by key, mapped read-only
+//             and binary-searched, so startup reads no more than the log tail
+// Processes on one host share the files: appends and compaction take an
+// exclusive flock on the log, readers a shared one, and the table is read
+// under that same lock. Compaction writes the table to a temporary file,
+// renames it into place, then empties the log.
+// Both files only ever hold "best so far" values, so replaying a record twice
+// is harmless.
+
+const uint32_t SCORE_LOG_MAGIC = 0x534e4b4c;   // "SNKL"
+const uint32_t SCORE_TABLE_MAGIC = 0x534e4b54; // "SNKT"
+const uint32_t SCORE_TABLE_VERSION = 1;
+const int SCORE_NAME_SIZE = 32;                // longer names are cut
+const int SCORE_COMPACT_AFTER = 256;           // log records that trigger a compaction
+
+const uint32_t SCORE_OBSTACLES = 1;
+const uint32_t SCORE_WRAP = 2;
+const uint32_t SCORE_POWER_UPS = 4;
+
+// Keys compare bytewise, which is the table's sort order
+struct ScoreKey {
+    char name[SCORE_NAME_SIZE]; // zero padded
+    uint32_t width, height;
+    uint32_t flags;             // SCORE_OBSTACLES | SCORE_WRAP | SCORE_POWER_UPS
+};
+
+struct ScoreRecord {
+    uint32_t magic;
+    uint32_t check;             // FNV-1a of the key and score; torn records fail it
+    ScoreKey key;
+    int32_t score;
+};
+
+struct ScoreTableHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t recordSize;
+};
+
+inline ScoreKey makeScoreKey(const std::string& name, const GameSettings& settings) {
+    ScoreKey key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.name, name.data(), std::min(name.size(), (size_t)SCORE_NAME_SIZE));
+    key.width = settings.width;
+    key.height = settings.height;
+    key.flags = (settings.enableObstacles ? SCORE_OBSTACLES : 0) | (settings.wrapAround ? SCORE_WRAP : 0) |
+                (settings.powerUps ? SCORE_POWER_UPS : 0);
+    return key;
+}
+
+inline bool scoreKeyLess(const ScoreKey& a, const ScoreKey& b) {
+    return memcmp(&a, &b, sizeof(ScoreKey)) < 0;
+}
+
+class ScoreStore {
+public:
+    // Opens (creating if needed) PATH.log and PATH.tbl. Failures are reported
+    // once and leave a store that keeps scores in memory only.
+    explicit ScoreStore(const std::string& path)
+        : logPath(path + ".log"), tablePath(path + ".tbl"), logFd(-1), table(nullptr), tableSize(0), tableIno(0), logRecords(0) {
+        logFd = open(logPath.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (logFd < 0) {
+            perror(logPath.c_str());
+            return;
+        }
+        // Table and log under one lock, so a compaction can't land in between
+        flock(logFd, LOCK_SH);
+        refresh();
+        flock(logFd, LOCK_UN);
+    }
+
+    ~ScoreStore() {
+        unmapTable();
+        if (logFd >= 0) close(logFd);
+    }
+
+    ScoreStore(const ScoreStore&) = delete;
+    ScoreStore& operator=(const ScoreStore&) = delete;
+
+    // Best score for the name on these settings, 0 if none
+    int best(const std::string& name, const GameSettings& settings) const {
+        return best(makeScoreKey(name, settings));
+    }
+
+    // Calls fn(key, score) for every stored best. A key can come up twice
+    // (table and log); the larger score is the best.
+    template <class Fn>
+    void forEach(Fn fn) const {
+        for (uint32_t i = 0; i < tableCount(); i++) fn(table[i].key, (int)table[i].score);
+        for (const ScoreRecord& r : recent) fn(r.key, (int)r.score);
+    }
+
+    // Keeps the score if it beats the stored best; returns true when it did
+    bool record(const std::string& name, const GameSettings& settings, int score) {
+        return record(makeScoreKey(name, settings), score);
+    }
+
+    bool record(const ScoreKey& key, int score) {
+        if (logFd < 0) {
+            if (score <= best(key)) return false;
+            remember(key, score);
+            return true;
+        }
+
+        ScoreRecord rec;
+        rec.magic = SCORE_LOG_MAGIC;
+        rec.key = key;
+        rec.score = score;
+        rec.check = checksum(rec);
+
+        flock(logFd, LOCK_EX);
+        // Another process may have raised this best since we last looked
+        refresh();
+        if (score <= best(key)) {
+            flock(logFd, LOCK_UN);
+            return false;
+        }
+        remember(key, score);
+        // A writer that died mid-record leaves a torn tail; cut it before
+        // appending so the records behind it stay aligned
+        struct stat st;
+        if (fstat(logFd, &st) == 0 && st.st_size % sizeof(ScoreRecord) != 0) {
+            if (ftruncate(logFd, st.st_size - st.st_size % sizeof(ScoreRecord)) != 0) perror(logPath.c_str());
+        }
+        if (write(logFd, &rec, sizeof(rec)) != (ssize_t)sizeof(rec) || fdatasync(logFd) != 0) {
+            perror(logPath.c_str());
+        }
+        logRecords = (fstat(logFd, &st) == 0 ? st.st_size : 0) / sizeof(ScoreRecord);
+        flock(logFd, LOCK_UN);
+
+        if (logRecords >= SCORE_COMPACT_AFTER) compact();
+        return true;
+    }
+
+    // Folds the log into a new table. The table is complete and synced
+    // before it replaces the old one, and the log is emptied only after that.
+    void compact() {
+        if (logFd < 0) return;
+        flock(logFd, LOCK_EX);
+        // Another process may have compacted or appended since we last looked
+        refresh();
+
+        std::vector<ScoreRecord> merged;
+        merged.reserve(tableCount() + recent.size());
+        std::vector<ScoreRecord>::const_iterator r = recent.begin();
+        for (uint32_t i = 0; i < tableCount() || r != recent.end();) {
+            if (r == recent.end() || (i < tableCount() && scoreKeyLess(table[i].key, r->key))) {
+                merged.push_back(table[i++]);
+            } else if (i < tableCount() && !scoreKeyLess(r->key, table[i].key)) {
+                merged.push_back(table[i].score >= r->score ? table[i] : *r);
+                i++;
+                r++;
+            } else {
+                merged.push_back(*r++);
+            }
+        }
+
+        std::string tmpPath = tablePath + ".tmp" + std::to_string(getpid());
+        int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ScoreTableHeader header = { SCORE_TABLE_MAGIC, SCORE_TABLE_VERSION, (uint32_t)merged.size(), (uint32_t)sizeof(ScoreRecord) };
+        bool ok = fd >= 0 && writeAll(fd, &header, sizeof(header)) &&
+                  writeAll(fd, merged.data(), merged.size() * sizeof(ScoreRecord)) && fsync(fd) == 0;
+        if (fd >= 0) close(fd);
+        if (ok && rename(tmpPath.c_str(), tablePath.c_str()) == 0) {
+            if (ftruncate(logFd, 0) != 0) perror(logPath.c_str());
+            logRecords = 0;
+            recent.clear();
+            unmapTable();
+            mapTable();
+        } else {
+            perror(tablePath.c_str());
+            unlink(tmpPath.c_str());
+        }
+        flock(logFd, LOCK_UN);
+    }
+
+private:
+    std::string logPath, tablePath;
+    int logFd;
+    const ScoreRecord* table;         // sorted, mapped from PATH.tbl
+    size_t tableSize;                 // bytes mapped, header included
+    ino_t tableIno;                   // PATH.tbl as last opened, 0 if missing
+    std::vector<ScoreRecord> recent;  // log records and our own, sorted by key
+    int logRecords;
+
+    uint32_t tableCount() const {
+        return table ? ((const ScoreTableHeader*)table - 1)->count : 0;
+    }
+
+    int best(const ScoreKey& key) const {
+        int score = 0;
+        const ScoreRecord* end = table + tableCount();
+        const ScoreRecord* t = std::lower_bound(table, end, key, [](const ScoreRecord& r, const ScoreKey& k) { return scoreKeyLess(r.key, k); });
+        if (t != end && memcmp(&t->key, &key, sizeof(key)) == 0) score = t->score;
+        std::vector<ScoreRecord>::const_iterator r = findRecent(key);
+        if (r != recent.end() && memcmp(&r->key, &key, sizeof(key)) == 0) score = std::max(score, (int)r->score);
+        return score;
+    }
+
+    std::vector<ScoreRecord>::const_iterator findRecent(const ScoreKey& key) const {
+        return std::lower_bound(recent.begin(), recent.end(), key, [](const ScoreRecord& r, const ScoreKey& k) { return scoreKeyLess(r.key, k); });
+    }
+
+    void remember(const ScoreKey& key, int score) {
+        std::vector<ScoreRecord>::iterator r = recent.begin() + (findRecent(key) - recent.begin());
+        if (r != recent.end() && memcmp(&r->key, &key, sizeof(key)) == 0) {
+            r->score = std::max((int)r->score, score);
+            return;
+        }
+        ScoreRecord rec;
+        rec.magic = SCORE_LOG_MAGIC;
+        rec.key = key;
+        rec.score = score;
+        rec.check = checksum(rec);
+        recent.insert(r, rec);
+    }
+
+    static uint32_t checksum(const ScoreRecord& rec) {
+        const unsigned char* p = (const unsigned char*)&rec.key;
+        size_t n = sizeof(rec.key) + sizeof(rec.score);
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * 16777619u;
+        return h;
+    }
+
+    static bool writeAll(int fd, const void* data, size_t size) {
+        const char* p = (const char*)data;
+        while (size > 0) {
+            ssize_t n = write(fd, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    // Catches up with other processes; the caller holds the log lock. A new
+    // table means a compaction emptied the log, so both are read afresh;
+    // otherwise only the records appended since the last look are read.
+    void refresh() {
+        struct stat st;
+        if ((stat(tablePath.c_str(), &st) == 0 ? st.st_ino : 0) != tableIno) {
+            unmapTable();
+            mapTable();
+            recent.clear();
+            logRecords = 0;
+        }
+        readLog();
+    }
+
+    // A missing, short or foreign table just counts as empty
+    void mapTable() {
+        int fd = open(tablePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat st;
+        bool known = fstat(fd, &st) == 0;
+        if (known) tableIno = st.st_ino; // even a foreign table, so it isn't reopened on every refresh
+        if (known && st.st_size >= (off_t)sizeof(ScoreTableHeader)) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                const ScoreTableHeader* h = (const ScoreTableHeader*)p;
+                if (h->magic == SCORE_TABLE_MAGIC && h->version == SCORE_TABLE_VERSION && h->recordSize == sizeof(ScoreRecord) &&
+                    sizeof(ScoreTableHeader) + (size_t)h->count * sizeof(ScoreRecord) <= (size_t)st.st_size) {
+                    table = (const ScoreRecord*)(h + 1);
+                    tableSize = st.st_size;
+                } else {
+                    munmap(p, st.st_size);
+                }
+            }
+        }
+        close(fd);
+    }
+
+    void unmapTable() {
+        if (table) munmap((void*)((const ScoreTableHeader*)table - 1), tableSize);
+        table = nullptr;
+        tableSize = 0;
+        tableIno = 0;
+    }
+
+    // Replays the log past the records already read into `recent`, skipping
+    // records that fail the checksum. The caller holds the log lock.
+    void readLog() {
+        ScoreRecord buf[256];
+        off_t offset = (off_t)logRecords * sizeof(ScoreRecord);
+        ssize_t got;
+        while ((got = pread(logFd, buf, sizeof(buf), offset)) > 0) {
+            int n = got / sizeof(ScoreRecord);
+            if (n == 0) break;
+            for (int i = 0; i < n; i++) {
+                if (buf[i].magic == SCORE_LOG_MAGIC && buf[i].check == checksum(buf[i])) remember(buf[i].key, buf[i].score);
+            }
+            logRecords += n;
+            offset += n * sizeof(ScoreRecord);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,466 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "snakeCore.h"
+#include "netProtocol.h"
+#include "eventLoop.h"
+#include "terminalRenderer.h"
+#include "predictor.h"
+
+using namespace std;
+
+// Terminal client for snakeServer, plus a scripted load mode that opens many
+// connections and plays random moves so the server can be measured on localhost.
+
+long long nowMicros() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Resolves host:port and connects; blocking unless nonBlocking is set.
+// A receiveBuffer above 0 shrinks the socket's receive buffer first.
+int connectTo(const string& host, int port, bool nonBlocking, int receiveBuffer = 0) {
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &res) != 0 || !res) return -1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | (nonBlocking ? SOCK_NONBLOCK : 0), 0);
+    if (fd >= 0 && receiveBuffer > 0) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+void sendAll(int fd, const string& data) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        ssize_t sent = send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return;
+        pos += sent;
+    }
+}
+
+void appendJoin(string& out, const string& name) {
+    MessageWriter w(out);
+    w.begin(MSG_JOIN);
+    w.str(name);
+    w.end();
+}
+
+void appendWatch(string& out, uint32_t room) {
+    MessageWriter w(out);
+    w.begin(MSG_WATCH);
+    w.u32(room);
+    w.end();
+}
+
+// JOIN for a player, WATCH for a spectator (watchRoom >= 0)
+void appendEnter(string& out, const string& name, long long watchRoom) {
+    if (watchRoom >= 0) appendWatch(out, watchRoom);
+    else appendJoin(out, name);
+}
+
+void appendInput(string& out, Direction d, uint32_t seq) {
+    MessageWriter w(out);
+    w.begin(MSG_INPUT);
+    w.u8(d);
+    w.u32(seq);
+    w.end();
+}
+
+// Plays one seat interactively, or watches a room when watchRoom >= 0;
+// returns when the player quits or the server goes away. With predict set
+// the player's own turns are shown before the server confirms them.
+int play(const string& host, int port, string name, long long watchRoom, bool predict) {
+    if (name.empty() && watchRoom < 0) {
+        cout << COLOR_BOLD COLOR_GREEN "Enter your name: " COLOR_RESET;
+        cin >> name;
+    }
+    int fd = connectTo(host, port, false);
+    if (fd < 0) {
+        cerr << "Could not connect to " << host << ":" << port << endl;
+        return 1;
+    }
+
+    GameCore core;         // confirmed: exactly what the server has sent
+    Predictor predictor;   // runs our own snake ahead of it
+    GameSettings settings;
+    vector<string> names;
+    vector<InputAck> acks;
+    TerminalRenderer renderer;
+    int slot = watchRoom >= 0 ? SPECTATOR_SLOT : 0;
+    int maxScore = 0;
+    bool inGame = false;
+    bool hasBoard = false; // deltas only apply on top of a keyframe
+    long long welcomeAt = 0;
+    string in, out;
+
+    appendEnter(out, name, watchRoom);
+    sendAll(fd, out);
+
+    {
+        EventLoop loop;
+        loop.watchSocket(fd);
+        renderer.updateTerminalSize();
+        cout << "\033[H\033[J" COLOR_BOLD "  Waiting for other players..." COLOR_RESET << flush;
+
+        bool running = true;
+        char key;
+        while (running) {
+            // Wake up for the next predicted phase as well as for server frames
+            bool predicting = predict && inGame && hasBoard && slot != SPECTATOR_SLOT;
+            long long due = predicting ? predictor.nextPhaseAt() : -1;
+            loop.armTimer(due < 0 ? 0 : max(1LL, due - nowMicros()));
+
+            EventLoop::Event ev = loop.next(key);
+            if (ev == EventLoop::QUIT) break;
+            bool redraw = false;
+            if (ev == EventLoop::RESIZE) {
+                renderer.updateTerminalSize();
+                continue;
+            }
+            if (ev == EventLoop::TICK) {
+                redraw = predicting && predictor.advance(nowMicros()) > 0;
+            }
+            if (ev == EventLoop::KEY) {
+                Direction d = STOP;
+                switch (key) {
+                    case 'w': case 'W': d = UP; break;
+                    case 's': case 'S': d = DOWN; break;
+                    case 'a': case 'A': d = LEFT; break;
+                    case 'd': case 'D': d = RIGHT; break;
+                    case 'r': case 'R':
+                        if (!inGame) {
+                            out.clear();
+                            appendEnter(out, name, watchRoom);
+                            sendAll(fd, out);
+                            cout << "\033[H\033[J" COLOR_BOLD "  Waiting for other players..." COLOR_RESET << flush;
+                        }
+                        break;
+                    case 'x': case 'X':
+                        running = false;
+                        break;
+                }
+                if (d != STOP && inGame && slot != SPECTATOR_SLOT) {
+                    uint32_t seq = predicting ? predictor.steer(d, nowMicros()) : 0;
+                    out.clear();
+                    appendInput(out, d, seq);
+                    sendAll(fd, out);
+                }
+            }
+            if (ev == EventLoop::SOCKET) {
+                char buf[65536];
+                ssize_t got = read(fd, buf, sizeof(buf));
+                if (got <= 0) {
+                    cout << "\033[H\033[J" COLOR_BOLD COLOR_RED "  Disconnected from server\n" COLOR_RESET << flush;
+                    break;
+                }
+                in.append(buf, got);
+
+                size_t pos = 0;
+                uint8_t type;
+                const char* payload;
+                size_t size;
+                bool bad = false;
+                while (nextMessage(in, pos, type, payload, size, bad)) {
+                    MessageReader r(payload, size);
+                    acks.clear();
+                    if (type == MSG_WELCOME) {
+                        r.u32(); // room id
+                        slot = r.u8();
+                        settings = readSettings(r);
+                        names.clear();
+                        for (int i = 0; i < settings.snakes; i++) names.push_back(r.str());
+                        if (!r.good()) bad = true;
+                        inGame = true;
+                        hasBoard = false;
+                        welcomeAt = nowMicros();
+                        renderer.requestFullRedraw();
+                    } else if (type == MSG_STATE && inGame) {
+                        if (!readState(r, core, settings, &acks)) bad = true;
+                        hasBoard = true;
+                        redraw = true;
+                        if (predict && slot != SPECTATOR_SLOT) predictor.resync(core, slot, acks, nowMicros());
+                    } else if (type == MSG_DELTA && inGame && hasBoard) {
+                        // A delta that doesn't fit leaves the board stale until the next keyframe
+                        hasBoard = readDelta(r, core, &acks);
+                        redraw = hasBoard;
+                        if (hasBoard && predict && slot != SPECTATOR_SLOT) predictor.confirm(core, acks, nowMicros());
+                    } else if (type == MSG_GAME_OVER) {
+                        inGame = false;
+                        redraw = false;
+                        if (r.u8() == 0 && slot == SPECTATOR_SLOT) {
+                            cout << "\033[H\033[J" COLOR_BOLD "  No game to watch yet\n\n"
+                                 << "  Press " COLOR_GREEN "R" COLOR_RESET COLOR_BOLD " to try again\n"
+                                 << "  Press " COLOR_RED "X" COLOR_RESET COLOR_BOLD " to exit\n" COLOR_RESET << flush;
+                            continue;
+                        }
+                        r = MessageReader(payload, size);
+                        int snakes = r.u8();
+                        cout << "\033[H\033[J" COLOR_BOLD COLOR_RED "\n  GAME OVER!\n\n" COLOR_RESET;
+                        for (int i = 0; i < snakes && r.good(); i++) {
+                            int score = r.i32();
+                            if (i == slot) maxScore = max(maxScore, score);
+                            cout << COLOR_BOLD << SNAKE_COLORS[i % SNAKE_COLOR_COUNT] << "  "
+                                 << (i < (int)names.size() ? names[i] : "?") << ": " COLOR_RESET COLOR_GREEN << score << COLOR_RESET "\n";
+                        }
+                        cout << COLOR_BOLD "  Max Score: " COLOR_YELLOW << maxScore << COLOR_RESET "\n\n"
+                             << COLOR_BOLD "  Press " COLOR_GREEN "R" COLOR_RESET COLOR_BOLD
+                             << (slot == SPECTATOR_SLOT ? " to watch another game\n" : " to play again\n")
+                             << "  Press " COLOR_RED "X" COLOR_RESET COLOR_BOLD " to exit\n" COLOR_RESET << flush;
+                    }
+                    if (bad) break;
+                }
+                if (bad) {
+                    cout << "\033[H\033[J" COLOR_BOLD COLOR_RED "  Bad message from server\n" COLOR_RESET << flush;
+                    break;
+                }
+                in.erase(0, pos);
+            }
+
+            if (redraw && inGame) {
+                // Players see the prediction, spectators the confirmed game
+                const GameCore& shown = predict && slot != SPECTATOR_SLOT ? predictor.view() : core;
+                if (slot < (int)shown.getSnakes().size()) maxScore = max(maxScore, shown.getSnakes()[slot].score);
+                PanelInfo info;
+                info.started = true;
+                info.elapsedSeconds = (nowMicros() - welcomeAt) / 1000000;
+                info.maxScore = maxScore;
+                info.focus = slot == SPECTATOR_SLOT ? -1 : slot;
+                renderer.draw(shown, names, info);
+            }
+        }
+    }
+    close(fd);
+
+    const RollbackStats& stats = predictor.getStats();
+    if (stats.confirmed + stats.rollbacks > 0) {
+        fprintf(stderr, "prediction: %lld phases confirmed, %lld rollbacks (%lld phases replayed, avg %lldus, max %lldus), rtt %lldus\n",
+                stats.confirmed, stats.rollbacks, stats.phasesReplayed,
+                stats.rollbacks ? stats.totalMicros / stats.rollbacks : 0, stats.maxMicros, predictor.roundTrip());
+    }
+    return 0;
+}
+
+struct LoadClient {
+    int fd;
+    string in, out;
+    bool connected;
+    bool idle;             // spectator with nothing to watch, retries each second
+    long long frames, keyframes;
+};
+
+// Opens `count` connections that join games and steer at random (or just
+// watch, when watchRoom >= 0), printing throughput once a second
+int loadTest(const string& host, int port, int count, int seconds, long long watchRoom, int slow) {
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    // The first `slow` clients get a tiny receive buffer and are read once a
+    // second, so the server has to skip them ahead instead of queueing
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    vector<LoadClient> clients(count);
+    for (int i = 0; i < count; i++) {
+        LoadClient& c = clients[i];
+        c.fd = connectTo(host, port, true, i < slow ? 4096 : 0);
+        c.connected = false;
+        c.idle = false;
+        c.frames = 0;
+        c.keyframes = 0;
+        if (c.fd < 0) {
+            cerr << "connect failed after " << i << " clients: " << strerror(errno) << endl;
+            return 1;
+        }
+        appendEnter(c.out, "load" + to_string(i), watchRoom);
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u32 = i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, c.fd, &ev);
+    }
+
+    long long frames = 0, keyframes = 0, games = 0, bytes = 0, dropped = 0;
+    long long lastFrames = 0, lastGames = 0, lastBytes = 0;
+    char buf[65536];
+
+    auto disconnect = [&](LoadClient& c) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+        c.fd = -1;
+        dropped++;
+    };
+
+    // Reads what has arrived and answers it like a player (or spectator) would
+    auto receive = [&](int i) {
+        LoadClient& c = clients[i];
+        while (c.fd >= 0) {
+            ssize_t got = read(c.fd, buf, sizeof(buf));
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) {
+                disconnect(c);
+                return;
+            }
+            bytes += got;
+            c.in.append(buf, got);
+        }
+        size_t pos = 0;
+        uint8_t type;
+        const char* payload;
+        size_t size;
+        bool bad = false;
+        string reply;
+        while (nextMessage(c.in, pos, type, payload, size, bad)) {
+            if (type == MSG_STATE || type == MSG_DELTA) {
+                frames++;
+                c.frames++;
+                if (type == MSG_STATE) {
+                    keyframes++;
+                    c.keyframes++;
+                }
+                if (watchRoom < 0 && rand() % 6 == 0) appendInput(reply, (Direction)(UP + rand() % 4), 0);
+            } else if (type == MSG_GAME_OVER) {
+                MessageReader r(payload, size);
+                if (watchRoom >= 0 && r.u8() == 0) {
+                    c.idle = true;
+                    continue;
+                }
+                games++;
+                // Spectators move on to whichever game is running next
+                appendEnter(reply, "load" + to_string(i), watchRoom >= 0 ? 0 : -1);
+            }
+        }
+        if (bad) {
+            disconnect(c);
+            return;
+        }
+        c.in.erase(0, pos);
+        if (!reply.empty() && c.fd >= 0) sendAll(c.fd, reply);
+    };
+
+    long long startAt = nowMicros(), nextReport = startAt + 1000000, endAt = startAt + seconds * 1000000LL;
+    struct epoll_event events[512];
+    while (nowMicros() < endAt) {
+        int n = epoll_wait(epollFd, events, 512, 100);
+        for (int e = 0; e < n; e++) {
+            int i = events[e].data.u32;
+            LoadClient& c = clients[i];
+            if (c.fd < 0) continue;
+            if (events[e].events & (EPOLLERR | EPOLLHUP)) {
+                disconnect(c);
+                continue;
+            }
+            if (events[e].events & EPOLLOUT) {
+                c.connected = true;
+                if (!c.out.empty()) {
+                    sendAll(c.fd, c.out);
+                    c.out.clear();
+                }
+                struct epoll_event ev = {};
+                ev.events = i < slow ? 0u : (uint32_t)EPOLLIN;
+                ev.data.u32 = i;
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+            }
+            if ((events[e].events & EPOLLIN) && i >= slow) receive(i);
+        }
+
+        long long now = nowMicros();
+        if (now >= nextReport) {
+            for (int i = 0; i < slow; i++) {
+                if (clients[i].connected) receive(i);
+            }
+            for (LoadClient& c : clients) {
+                if (!c.idle || c.fd < 0) continue;
+                c.idle = false;
+                string retry;
+                appendWatch(retry, 0);
+                sendAll(c.fd, retry);
+            }
+            long long newFrames = frames - lastFrames;
+            fprintf(stderr, "clients %d | frames/s %lld | games/s %lld | in %.1f KB/s (%.1f B/frame) | dropped %lld\n",
+                    count, newFrames, games - lastGames, (bytes - lastBytes) / 1024.0,
+                    newFrames ? (double)(bytes - lastBytes) / newFrames : 0.0, dropped);
+            lastFrames = frames;
+            lastGames = games;
+            lastBytes = bytes;
+            nextReport += 1000000;
+        }
+    }
+    double elapsed = (nowMicros() - startAt) / 1e6;
+    fprintf(stderr, "total: %lld frames (%lld keyframes), %lld games, %.1f MB in %.1fs (%.0f frames/s, %.1f B/frame)\n",
+            frames, keyframes, games, bytes / 1048576.0, elapsed, frames / elapsed, frames ? (double)bytes / frames : 0.0);
+    if (slow) {
+        long long slowFrames = 0, slowKeyframes = 0;
+        for (int i = 0; i < slow; i++) {
+            slowFrames += clients[i].frames;
+            slowKeyframes += clients[i].keyframes;
+        }
+        fprintf(stderr, "slow clients: %lld frames (%lld keyframes) each on average\n", slowFrames / slow, slowKeyframes / slow);
+    }
+    for (LoadClient& c : clients) {
+        if (c.fd >= 0) close(c.fd);
+    }
+    close(epollFd);
+    return 0;
+}
+
+// Usage: snakeClient [--host H] [--port N] [--name NAME | --watch [ROOM]] [--no-predict]
+//        snakeClient --load N [--seconds S] [--slow N] [--watch [ROOM]] [--host H] [--port N]
+int main(int argc, char* argv[]) {
+    string host = "127.0.0.1", name;
+    int port = DEFAULT_PORT, load = 0, seconds = 10, slow = 0;
+    long long watchRoom = -1;
+    bool predict = true;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--host" && i + 1 < argc) {
+            host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (arg == "--name" && i + 1 < argc) {
+            name = argv[++i];
+        } else if (arg == "--load" && i + 1 < argc) {
+            load = max(1, atoi(argv[++i]));
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            seconds = max(1, atoi(argv[++i]));
+        } else if (arg == "--slow" && i + 1 < argc) {
+            slow = max(0, atoi(argv[++i]));
+        } else if (arg == "--no-predict") {
+            predict = false;
+        } else if (arg == "--watch") {
+            // Optional room id; without one the server picks a running game
+            watchRoom = i + 1 < argc && argv[i + 1][0] != '-' ? atoll(argv[++i]) : 0;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--host H] [--port N] [--name NAME | --watch [ROOM]] [--no-predict]\n"
+                 << "       " << argv[0] << " --load N [--seconds S] [--slow N] [--watch [ROOM]] [--host H] [--port N]" << endl;
+            return 1;
+        }
+    }
+
+    srand(time(0));
+    if (load) return loadTest(host, port, load, seconds, watchRoom, min(slow, load));
+    return play(host, port, name, watchRoom, predict);
+}
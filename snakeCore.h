@@ -0,0 +1,1046 @@
+#ifndef SNAKE_CORE_H
+#define SNAKE_CORE_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+#include "chunkedGrid.h"
+#include "entityStore.h"
+#include "fruitIndex.h"
+#include "levelGenerator.h"
+#include "levelPack.h"
+#include "levelMap.h"
+#include "timerWheel.h"
+#include "tracer.h"
+
+// Headless game rules: board, snakes, fruits and obstacles, with no terminal
+// or wall-clock dependencies. Time is an integer game clock in microseconds
+// and randomness comes from a seeded generator, so the same seed and the same
+// inputs always produce the same game.
+
+// Default game dimensions; huge-board runs pass --board WxH
+const int WIDTH = 60;
+const int HEIGHT = 30;
+const int MAX_BOARD_SIDE = 100000;
+const int MAX_SNAKES = 8;
+
+const int START_SPEED = 120000; // Increased speed by 1.25X (original: 150000)
+const int FASTEST_SPEED = 45000;
+const int SLOWEST_SPEED = 300000;
+
+// Timed fruits and effects count in ticks of the game clock, each one step
+// at the starting speed
+const int EFFECT_TICK = START_SPEED;
+const int POWER_UP_TICKS = 100;       // how long an effect lasts
+const int POWER_UP_FRUIT_TICKS = 50;  // an uneaten power-up vanishes after this
+const int POWER_UP_PERCENT = 10;      // of fruits, when power-ups are on
+const int PATROL_MAX_LENGTH = 12;     // cells a patrolling hazard walks before turning back
+
+// Boards up to this many cells (and 65536 wide) get a step table (see
+// GameCore::buildSteps); bigger ones work their steps out as they go
+const size_t STEP_TABLE_MAX_CELLS = 1 << 18;
+
+// Kept free of obstacles around each starting snake: its body, one cell
+// behind it, START_CLEAR_AHEAD cells ahead and START_CLEAR_SIDE rows either side
+const int START_CLEAR_AHEAD = 5;
+const int START_CLEAR_SIDE = 2;
+
+enum Direction { STOP = 0, UP, DOWN, LEFT, RIGHT };
+
+// Step per direction, indexed by Direction
+const int DIR_DX[] = { 0, 0, 0, -1, 1 };
+const int DIR_DY[] = { 0, -1, 1, 0, 0 };
+const Direction OPPOSITE[] = { STOP, DOWN, UP, RIGHT, LEFT };
+
+// Folds a coordinate that stepped one cell off the board back onto the opposite
+// edge. Branchless: the comparisons become masks, so the hot path has no jumps.
+inline int wrapCoord(int v, int size) {
+    return v + (size & -(v < 0)) - (size & -(v >= size));
+}
+
+struct Cell {
+    int x, y;
+};
+
+// What the board alone makes of a step, before bodies and hazards
+enum StepFate : uint8_t {
+    STEP_CLEAR,
+    STEP_WALL,  // onto an obstacle: fatal unless a ghost
+    STEP_DIES   // off a non-wrapping edge
+};
+
+// One entry of the step table: the cell a step lands on and its fate, in
+// one 8-byte load
+struct StepTarget {
+    uint16_t x, y;
+    StepFate fate;
+    uint8_t pad[3];
+};
+
+// Where the head of snake i of n starts: the middle column, on evenly spaced
+// rows; the body trails to the left
+inline Cell startHead(int width, int height, int snakes, int i) {
+    return Cell{ width / 2, (i + 1) * height / (snakes + 1) };
+}
+
+// Reserves a starting snake's zone in a level being generated
+inline void keepStartClear(LevelGenerator& level, Cell head) {
+    level.keepClear(head.x - 3, head.y - START_CLEAR_SIDE, head.x + START_CLEAR_AHEAD, head.y + START_CLEAR_SIDE);
+}
+
+// splitmix64: one 64-bit word of state, so it is trivial to seed and to save
+struct GameRng {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    int below(int n) { return (int)(next() % (uint64_t)n); }
+};
+
+// Power-up effects, in the order of their fruits (GHOST_FRUIT onwards):
+// a ghost goes through obstacles, double score doubles what fruit is worth,
+// slow motion doubles the time a step takes
+enum Effect { GHOST, DOUBLE_SCORE, SLOW_MOTION, EFFECT_COUNT };
+
+// What eating each FruitType does, so a new kind of fruit is a row here
+struct FruitKind {
+    int points;
+    int speedChange;  // added to the snake's step time, within FASTEST_SPEED..SLOWEST_SPEED
+    int effect;       // Effect started for POWER_UP_TICKS, or -1
+};
+
+const FruitKind FRUIT_KINDS[] = {
+    { 10, -15000, -1 },           // NORMAL
+    {  5,  10000, -1 },           // SLOW
+    {  5,      0, GHOST },        // GHOST_FRUIT
+    {  5,      0, DOUBLE_SCORE }, // DOUBLE_FRUIT
+    {  5,      0, SLOW_MOTION },  // SLOWMO_FRUIT
+};
+
+static_assert(sizeof(FRUIT_KINDS) / sizeof(FRUIT_KINDS[0]) == FRUIT_TYPE_COUNT, "a kind for every fruit type");
+
+struct Snake {
+    std::deque<Cell> body; // front() is the head
+    Direction dir;
+    int score;
+    int speed;             // microseconds per horizontal step; vertical steps take 1.5x
+    long long nextMoveAt;  // game clock of this snake's next step
+    bool alive;
+    bool bot;
+    int fruitsEaten;
+    long long effectEnds[EFFECT_COUNT] = {}; // game clock each effect runs until
+};
+
+// Effects are checked against the clock where they matter, so running out
+// costs nothing and needs no timer
+inline bool hasEffect(const Snake& s, Effect e, long long clock) {
+    return s.effectEnds[e] > clock;
+}
+
+// One entry of the change journal a server turns into per-tick deltas.
+// Replayed in order on a copy of the same board, it reproduces the game
+// exactly, down to the random generator.
+enum ChangeKind {
+    SNAKE_MOVED, SNAKE_GREW, SNAKE_DIED, SNAKE_SCORED, FRUIT_ADDED, FRUIT_REMOVED,
+    SNAKE_STEERED, // a player's turn, taken between phases
+    PHASE_STARTED, // the clock jumped to the next phase (nextMoveTime())
+    RNG_ADVANCED   // fruits were spawned; carries the generator's new state
+};
+
+struct BoardChange {
+    ChangeKind kind;
+    int snake;       // snake changes
+    Direction dir;   // moves and steers: the new heading
+    int score;       // SNAKE_SCORED: the new score
+    Fruit fruit;     // fruit changes
+    uint64_t rng;    // RNG_ADVANCED: the generator state
+};
+
+// How a hazard moves, one cell per effect tick. A patrol walks a straight
+// path of patrolLength cells from where it started and back, turning early
+// when something is in the way; a bouncer (patrolLength 0) goes diagonally
+// and reflects off whatever it meets.
+struct Motion {
+    int8_t dx, dy;           // patrol: the path's direction; bouncer: its heading
+    int8_t heading;          // patrol: +1 outwards along the path, -1 back
+    uint8_t pad;
+    uint16_t patrolLength;
+    uint16_t patrolAt;       // patrol: cells from the start of the path
+};
+
+// Board items with state of their own, one component per aspect (see
+// entityStore.h). Walls stay bits in the grid and fruits stay in FruitIndex,
+// which bots search by distance; entities are for kinds that change per
+// entity as the game runs. Hazards have a position and a motion; portals a
+// position and an exit, the cell of the other end of their pair.
+struct BoardEntities {
+    EntityPool pool;
+    Components<Cell> position;
+    Components<Motion> motion;
+    Components<Cell> exit;
+    long long movedTick = 0; // effect tick the hazards last moved on
+
+    void clear() {
+        pool.clear();
+        position.clear();
+        motion.clear();
+        exit.clear();
+        movedTick = 0;
+    }
+
+    void destroy(Entity e) {
+        position.remove(e);
+        motion.remove(e);
+        exit.remove(e);
+        pool.destroy(e);
+    }
+};
+
+// Everything a round changes while it is played. Obstacles are fixed for the
+// round and stay in the grid, so a snapshot is O(snakes + fruits + entities)
+// to take and to restore however big the board is.
+struct GameSnapshot {
+    long long clock;
+    bool started;
+    GameRng rng;
+    std::vector<Snake> snakes;
+    FruitIndex fruits;
+    BoardEntities entities;
+};
+
+struct GameSettings {
+    int width = WIDTH;
+    int height = HEIGHT;
+    int fruits = 0;        // fruits at start, 0 = random 2..8
+    int obstacles = 0;     // obstacle cells for scatter and walls, 0 = random 8..32 / a sixteenth of the board
+    bool enableObstacles = true;
+    LevelStyle level = LEVEL_SCATTER; // obstacle layout
+    const LevelPack* levels = nullptr;  // when it fits the board, levels are picked from this pack instead
+    const LevelMap* map = nullptr;      // a hand-made board: walls, starts and fruit zones; size and wrapping must match it
+    bool wrapAround = false; // leaving one edge re-enters at the opposite one
+    int fruitLifetime = 0; // effect ticks a fruit lasts uneaten, 0 = forever
+    int hazards = 0;       // moving hazards, every other one a patrol and the rest bouncers
+    int portals = 0;       // pairs of portal cells; entering either end comes out of the other
+    bool powerUps = false; // some fruits are power-ups
+    int snakes = 1;        // 1..MAX_SNAKES; the first `humans` are steered by players
+    int humans = 1;
+};
+
+class GameCore {
+public:
+    explicit GameCore(const GameSettings& settings = GameSettings()) : settings(settings), journaling(false) {
+        reset(0);
+    }
+
+    // Starts a new round. Snakes are laid out on evenly spaced rows, all
+    // facing right; nothing moves until start() or a human steers.
+    void reset(uint64_t seed) {
+        rng.state = seed;
+        clock = 0;
+        started = false;
+        changes.clear();
+        grid.resize(settings.width, settings.height);
+
+        snakes.assign(settings.snakes, Snake());
+        for (int i = 0; i < settings.snakes; i++) {
+            Snake& s = snakes[i];
+            s.dir = STOP;
+            s.score = 0;
+            s.speed = START_SPEED;
+            s.nextMoveAt = 0;
+            s.alive = true;
+            s.bot = i >= settings.humans;
+            s.fruitsEaten = 0;
+            Cell head = startCell(i);
+            for (int k = 0; k < 3; k++) {
+                Cell c = { head.x - k, head.y };
+                s.body.push_back(c);
+                grid.set(BODY_LAYER, c.x, c.y);
+            }
+        }
+
+        entities.clear();
+        spawnObstacles();
+        spawnPortals();
+        spawnHazards();
+        buildSteps();
+        expiries.reset(0);
+        int numFruits = settings.fruits ? settings.fruits : rng.below(7) + 2;
+        numFruits = (int)std::min((long long)numFruits, (long long)settings.width * settings.height);
+        fruits.reset(settings.width, settings.height, numFruits);
+        for (int i = 0; i < numFruits; i++) {
+            if (!spawnFruit()) break; // the board is full
+        }
+    }
+
+    // Sets the bots moving (the humans start by steering)
+    void start() {
+        if (started) return;
+        started = true;
+        for (Snake& s : snakes) {
+            if (s.bot && s.alive) {
+                s.dir = RIGHT;
+                s.nextMoveAt = clock + period(s);
+            }
+        }
+    }
+
+    // Player input; a snake can't turn back onto its neck. That is checked
+    // against the body, not the heading: two quick turns before the next
+    // step would otherwise add up to a reversal.
+    void steer(int i, Direction d) {
+        Snake& s = snakes[i];
+        if (!s.alive || d == STOP) return;
+        if (s.body.size() > 1) {
+            Cell next = step(s.body.front(), d), neck = s.body[1];
+            if (next.x == neck.x && next.y == neck.y) return;
+        }
+        bool wasStopped = s.dir == STOP;
+        s.dir = d;
+        if (wasStopped) s.nextMoveAt = clock + period(s);
+        record(SNAKE_STEERED, i, d);
+    }
+
+    // Game clock of the next phase, or -1 if no snake is moving
+    long long nextMoveTime() const {
+        long long due = -1;
+        for (const Snake& s : snakes) {
+            if (s.alive && s.dir != STOP && (due < 0 || s.nextMoveAt < due)) due = s.nextMoveAt;
+        }
+        return due;
+    }
+
+    // Advances the clock to the next phase and moves every snake due at that
+    // instant simultaneously. Hazards take the steps they are due first. Then
+    // everything is checked against the board as it was before the snakes
+    // moved, so the outcome doesn't depend on snake order: entering any body
+    // cell (tails included), a wall or a hazard kills, and two heads claiming
+    // the same cell both die. Claims go through scratch layers of the shared
+    // occupancy grid, so the phase costs O(1) per moving snake.
+    void stepPhase() {
+        long long due = nextMoveTime();
+        if (due < 0) return;
+        clock = due;
+        record(PHASE_STARTED, 0);
+        moveHazards();
+        int expired = expireFruits();
+
+        int moving[MAX_SNAKES];
+        Cell target[MAX_SNAKES];
+        bool dies[MAX_SNAKES];
+        bool claimed[MAX_SNAKES];
+        int n = 0;
+        for (int i = 0; i < (int)snakes.size(); i++) {
+            Snake& s = snakes[i];
+            if (s.alive && s.dir != STOP && s.nextMoveAt == due) {
+                if (s.bot) steerBot(s);
+                moving[n++] = i;
+            }
+        }
+
+        for (int k = 0; k < n; k++) {
+            const Snake& s = snakes[moving[k]];
+            Cell c;
+            claimed[k] = false;
+            dies[k] = stepBlocked(s.body.front(), s.dir, s, c);
+            target[k] = c;
+            if (dies[k]) continue;
+            if (grid.test(CLAIM_LAYER, c.x, c.y)) grid.set(CONTEST_LAYER, c.x, c.y);
+            else grid.set(CLAIM_LAYER, c.x, c.y);
+            claimed[k] = true;
+        }
+        for (int k = 0; k < n; k++) {
+            if (claimed[k] && grid.test(CONTEST_LAYER, target[k].x, target[k].y)) dies[k] = true;
+        }
+        for (int k = 0; k < n; k++) {
+            if (!claimed[k]) continue;
+            grid.reset(CLAIM_LAYER, target[k].x, target[k].y);
+            grid.reset(CONTEST_LAYER, target[k].x, target[k].y);
+        }
+
+        int eaten = 0;
+        for (int k = 0; k < n; k++) {
+            Snake& s = snakes[moving[k]];
+            if (dies[k]) {
+                kill(s);
+                continue;
+            }
+            Cell c = target[k];
+            s.body.push_front(c);
+            grid.set(BODY_LAYER, c.x, c.y);
+
+            const Fruit* fruit = grid.test(FRUIT_LAYER, c.x, c.y) ? fruits.find(c.x, c.y) : nullptr;
+            record(fruit ? SNAKE_GREW : SNAKE_MOVED, moving[k], s.dir);
+            if (fruit) {
+                feed(s, fruit->type);
+                record(SNAKE_SCORED, moving[k], s.dir, s.score);
+                removeFruit(c.x, c.y);
+                eaten++;
+            } else {
+                Cell t = s.body.back();
+                s.body.pop_back();
+                grid.reset(BODY_LAYER, t.x, t.y);
+            }
+            s.nextMoveAt = clock + period(s);
+        }
+
+        // Replacements, for eaten fruits in snake order and then for expired
+        // ones, are placed after every snake has moved
+        for (int i = 0; i < eaten + expired; i++) {
+            spawnFruit();
+        }
+        if (eaten + expired) record(RNG_ADVANCED, 0, STOP, 0, Fruit(), rng.state);
+    }
+
+    // Over when every human is dead; a bots-only game runs until no snake is left
+    bool isOver() const {
+        for (const Snake& s : snakes) {
+            if (s.alive && (settings.humans == 0 || !s.bot)) return false;
+        }
+        return true;
+    }
+
+    // Change journal: while on, every board change is appended in the order
+    // it happened, so a server can send what changed instead of the board
+    void recordChanges(bool on) {
+        journaling = on;
+        changes.clear();
+    }
+    const std::vector<BoardChange>& getChanges() const { return changes; }
+    void clearChanges() { changes.clear(); }
+
+    // Replica interface: a network client rebuilds the server's board through
+    // these instead of simulating it. clearBoard() leaves an empty board with
+    // settings.snakes dead, bodiless snakes. The first restore() afterwards
+    // finishes the board: it takes the portals from the snapshot and builds
+    // the step table over them and the obstacles placed meanwhile.
+    void clearBoard(const GameSettings& newSettings) {
+        settings = newSettings;
+        grid.resize(settings.width, settings.height);
+        fruits.reset(settings.width, settings.height, std::max(1, settings.fruits));
+        expiries.reset(0);
+        entities.clear();
+        steps.clear();
+        stepsPending = true;
+        snakes.assign(settings.snakes, Snake());
+        for (int i = 0; i < settings.snakes; i++) {
+            snakes[i].dir = STOP;
+            snakes[i].score = 0;
+            snakes[i].speed = START_SPEED;
+            snakes[i].nextMoveAt = 0;
+            snakes[i].alive = false;
+            snakes[i].bot = i >= settings.humans;
+            snakes[i].fruitsEaten = 0;
+        }
+        started = true;
+    }
+
+    // Between clearBoard() and restore() only: walls are in the step table
+    void placeObstacle(int x, int y) { grid.set(OBSTACLE_LAYER, x, y); }
+    void placeFruit(const Fruit& fruit) { addFruit(fruit); }
+    void takeFruit(int x, int y) { removeFruit(x, y); }
+    void setClock(long long t) { clock = t; }
+
+    // Replays PHASE_STARTED; false if no snake was due to move. Hazards aren't
+    // journaled: they move here just as they do on the server.
+    bool beginPhase() {
+        long long due = nextMoveTime();
+        if (due < 0) return false;
+        clock = due;
+        moveHazards();
+        return true;
+    }
+
+    // Replays a move: the head steps one cell in d, the tail follows unless
+    // the snake grew on the fruit under the new head. That fruit stays until
+    // its own FRUIT_REMOVED entry.
+    bool moveSnake(int i, Direction d, bool grew) {
+        Snake& s = snakes[i];
+        if (s.body.empty() || d == STOP) return false;
+        Cell c = step(s.body.front(), d);
+        if (c.x < 0 || c.x >= settings.width || c.y < 0 || c.y >= settings.height) return false;
+        s.dir = d;
+        s.body.push_front(c);
+        grid.set(BODY_LAYER, c.x, c.y);
+        if (grew) {
+            const Fruit* fruit = isFruit(c.x, c.y) ? fruits.find(c.x, c.y) : nullptr;
+            if (!fruit) return false;
+            feed(s, fruit->type);
+        } else {
+            Cell t = s.body.back();
+            s.body.pop_back();
+            grid.reset(BODY_LAYER, t.x, t.y);
+        }
+        s.nextMoveAt = clock + period(s);
+        return true;
+    }
+    void killSnake(int i) { kill(snakes[i]); }
+    void setScore(int i, int score) { snakes[i].score = score; }
+    void setRngState(uint64_t state) { rng.state = state; }
+    // Where a restored game's next rounds come from, as saves don't keep
+    // these; a map for another board size is left out
+    void setLevelSources(const LevelPack* pack, const LevelMap* map) {
+        settings.levels = pack;
+        settings.map = map && map->getWidth() == settings.width && map->getHeight() == settings.height ? map : nullptr;
+    }
+
+    // Copies out the moving parts of the game, reusing out's storage
+    void snapshot(GameSnapshot& out) const {
+        out.clock = clock;
+        out.started = started;
+        out.rng = rng;
+        out.snakes = snakes;
+        out.fruits = fruits;
+        out.entities = entities;
+    }
+
+    // Puts a snapshot back. It must come from a game with the same settings,
+    // obstacles and portals; only the body and fruit bits of the grid are rewritten,
+    // and the fruit timers are rebuilt from the fruits.
+    void restore(const GameSnapshot& in) {
+        for (const Snake& s : snakes) {
+            for (const Cell& c : s.body) grid.reset(BODY_LAYER, c.x, c.y);
+        }
+        for (size_t i = 0; i < fruits.size(); i++) grid.reset(FRUIT_LAYER, fruits[i].x, fruits[i].y);
+        for (size_t i = 0; i < entities.motion.size(); i++) {
+            Cell c = entities.position.get(entities.motion.owner(i));
+            grid.reset(HAZARD_LAYER, c.x, c.y);
+        }
+        clock = in.clock;
+        started = in.started;
+        rng = in.rng;
+        snakes = in.snakes;
+        fruits = in.fruits;
+        entities = in.entities;
+        for (const Snake& s : snakes) {
+            for (const Cell& c : s.body) grid.set(BODY_LAYER, c.x, c.y);
+        }
+        for (size_t i = 0; i < fruits.size(); i++) grid.set(FRUIT_LAYER, fruits[i].x, fruits[i].y);
+        for (size_t i = 0; i < entities.motion.size(); i++) {
+            Cell c = entities.position.get(entities.motion.owner(i));
+            grid.set(HAZARD_LAYER, c.x, c.y);
+        }
+        expiries.reset(clock / EFFECT_TICK);
+        for (size_t i = 0; i < fruits.size(); i++) scheduleExpiry(fruits[i]);
+        if (stepsPending) {
+            for (size_t i = 0; i < entities.exit.size(); i++) {
+                Cell c = entities.position.get(entities.exit.owner(i));
+                grid.set(PORTAL_LAYER, c.x, c.y);
+            }
+            buildSteps();
+        }
+    }
+
+    // Cheap hash of the game's progress: clock, generator, fruit count and
+    // each snake's ends and stats. Two replicas that agree on it have, in
+    // practice, played the same moves.
+    uint64_t fingerprint() const {
+        uint64_t h = 0x84222325CBF29CE4ULL;
+        auto mix = [&h](uint64_t v) {
+            h ^= v;
+            h *= 0x100000001B3ULL;
+            h ^= h >> 29;
+        };
+        mix(clock);
+        mix(rng.state);
+        mix(fruits.size());
+        for (const Snake& s : snakes) {
+            mix((uint64_t)s.alive << 32 | (uint64_t)s.dir << 16 | s.body.size());
+            mix((uint64_t)(uint32_t)s.score << 32 | (uint32_t)s.speed);
+            mix(s.nextMoveAt);
+            for (long long end : s.effectEnds) {
+                if (end) mix(end); // so games without power-ups hash as they always did
+            }
+            if (!s.body.empty()) {
+                mix((uint64_t)s.body.front().x << 32 | (uint32_t)s.body.front().y);
+                mix((uint64_t)s.body.back().x << 32 | (uint32_t)s.body.back().y);
+            }
+        }
+        if (entities.motion.size()) {
+            mix(entities.movedTick);
+            for (size_t i = 0; i < entities.motion.size(); i++) {
+                Cell c = entities.position.get(entities.motion.owner(i));
+                mix((uint64_t)c.x << 32 | (uint32_t)c.y);
+            }
+        }
+        return h;
+    }
+
+    template <class Fn>
+    void forEachObstacle(Fn fn) const { grid.forEach(OBSTACLE_LAYER, fn); }
+
+    bool isObstacle(int x, int y) const { return grid.test(OBSTACLE_LAYER, x, y); }
+    bool isSnakeBody(int x, int y) const { return grid.test(BODY_LAYER, x, y); }
+    bool isFruit(int x, int y) const { return grid.test(FRUIT_LAYER, x, y); }
+    bool isHazard(int x, int y) const { return grid.test(HAZARD_LAYER, x, y); }
+    bool isPortal(int x, int y) const { return grid.test(PORTAL_LAYER, x, y); }
+
+    // Where snake i's head goes if it steps in d; (-1, -1) off the edge
+    Cell nextHead(int i, Direction d) const { return step(snakes[i].body.front(), d); }
+
+    const GameSettings& getSettings() const { return settings; }
+    int getWidth() const { return settings.width; }
+    int getHeight() const { return settings.height; }
+    long long getClock() const { return clock; }
+    bool isStarted() const { return started; }
+    uint64_t getRngState() const { return rng.state; }
+    const std::vector<Snake>& getSnakes() const { return snakes; }
+    const FruitIndex& getFruits() const { return fruits; }
+    const BoardEntities& getEntities() const { return entities; }
+    const ChunkedGrid& getGrid() const { return grid; }
+
+private:
+    GameSettings settings;
+    GameRng rng;
+    long long clock;
+    bool started;
+    ChunkedGrid grid;  // obstacles, bodies and fruits; the only place obstacles live
+    FruitIndex fruits; // bucketed by position; the FRUIT_LAYER bit mirrors it for fast checks
+    std::vector<Snake> snakes;
+    BoardEntities entities;
+    bool journaling;
+    std::vector<BoardChange> changes;
+    LevelGenerator level; // kept for its buffers; only used by reset()
+    HierarchicalTimerWheel expiries; // timed fruits by cell, in effect ticks; only the simulating side fills it
+    std::vector<uint64_t> expired;   // expireFruits()'s scratch
+    std::vector<StepTarget> steps;   // step table, 4 entries per board cell; empty when too big
+    bool stepsPending = false;       // clearBoard() ran and restore() hasn't built the table yet
+
+    void record(ChangeKind kind, int snake, Direction dir = STOP, int score = 0, Fruit fruit = Fruit(), uint64_t rngState = 0) {
+        if (!journaling) return;
+        BoardChange change = { kind, snake, dir, score, fruit, rngState };
+        changes.push_back(change);
+    }
+
+    // Eating: red fruit scores more and speeds the snake up, green slows it,
+    // a power-up scores like green and starts (or restarts) its effect
+    void feed(Snake& s, FruitType type) {
+        const FruitKind& kind = FRUIT_KINDS[type];
+        if (kind.speedChange) s.speed = std::max(FASTEST_SPEED, std::min(SLOWEST_SPEED, s.speed + kind.speedChange));
+        if (kind.effect >= 0) s.effectEnds[kind.effect] = clock + (long long)POWER_UP_TICKS * EFFECT_TICK;
+        s.score += hasEffect(s, DOUBLE_SCORE, clock) ? 2 * kind.points : kind.points;
+        s.fruitsEaten++;
+    }
+
+    int period(const Snake& s) const {
+        int p = (s.dir == UP || s.dir == DOWN) ? (s.speed*3)/2 : s.speed;
+        return hasEffect(s, SLOW_MOTION, clock) ? 2 * p : p;
+    }
+
+    // The map's starts where it has them, evenly spaced rows otherwise
+    Cell startCell(int i) const {
+        if (settings.map && i < settings.map->startCount()) {
+            MapStart s = settings.map->start(i);
+            return Cell{ s.x, s.y };
+        }
+        return startHead(settings.width, settings.height, settings.snakes, i);
+    }
+
+    // Next head position in d (never STOP), (-1, -1) off the edge
+    Cell step(Cell c, Direction d) const {
+        if (steps.empty()) return computeStep(c, d);
+        const StepTarget& t = steps[((size_t)c.y * settings.width + c.x) * 4 + (d - UP)];
+        return t.fate == STEP_DIES ? Cell{ -1, -1 } : Cell{ t.x, t.y };
+    }
+
+    // Where s's head goes in d, and whether that kills it. With the table,
+    // the landing cell, the edge and the walls are one load and only what
+    // moves during a round (bodies, hazards) is looked up in the grid.
+    bool stepBlocked(Cell head, Direction d, const Snake& s, Cell& to) const {
+        if (steps.empty()) {
+            to = computeStep(head, d);
+            return blocked(to, s);
+        }
+        const StepTarget& t = steps[((size_t)head.y * settings.width + head.x) * 4 + (d - UP)];
+        to = Cell{ t.x, t.y };
+        if (t.fate == STEP_DIES || (t.fate == STEP_WALL && !hasEffect(s, GHOST, clock))) return true;
+        return grid.any(layerBit(BODY_LAYER) | layerBit(HAZARD_LAYER), to.x, to.y);
+    }
+
+    // A step worked out: wrapping or off a non-wrapping edge to (-1, -1),
+    // and from a portal's cell on to the other end of its pair
+    Cell computeStep(Cell c, Direction d) const {
+        Cell n = shifted(c, DIR_DX[d], DIR_DY[d]);
+        if (offBoard(n)) return Cell{ -1, -1 };
+        if (entities.exit.size() && grid.test(PORTAL_LAYER, n.x, n.y)) return portalExit(n);
+        return n;
+    }
+
+    Cell portalExit(Cell c) const {
+        for (size_t i = 0; i < entities.exit.size(); i++) {
+            Cell at = entities.position.get(entities.exit.owner(i));
+            if (at.x == c.x && at.y == c.y) return entities.exit[i];
+        }
+        return c;
+    }
+
+    // Precomputes every step on the board as it is set up, so features that
+    // bend movement (wrapping, portals) or end it (edges, walls) cost nothing
+    // per move. Only what is fixed for the round goes in; bodies, fruits and
+    // hazards are checked after the step.
+    void buildSteps() {
+        stepsPending = false;
+        size_t cells = (size_t)settings.width * settings.height;
+        if (cells > STEP_TABLE_MAX_CELLS || settings.width > UINT16_MAX + 1) {
+            steps.clear();
+            return;
+        }
+        steps.resize(cells * 4);
+        StepTarget* out = steps.data();
+        for (int y = 0; y < settings.height; y++) {
+            for (int x = 0; x < settings.width; x++) {
+                for (int d = UP; d <= RIGHT; d++, out++) {
+                    Cell n = computeStep(Cell{ x, y }, (Direction)d);
+                    *out = StepTarget();
+                    if (offBoard(n)) {
+                        out->fate = STEP_DIES;
+                        continue;
+                    }
+                    out->x = n.x;
+                    out->y = n.y;
+                    out->fate = grid.test(OBSTACLE_LAYER, n.x, n.y) ? STEP_WALL : STEP_CLEAR;
+                }
+            }
+        }
+    }
+
+    // A ghost goes through obstacles, but never through a body, a hazard or
+    // the edge
+    bool blocked(Cell c, const Snake& s) const {
+        if (offBoard(c)) return true;
+        unsigned walls = hasEffect(s, GHOST, clock) ? 0 : layerBit(OBSTACLE_LAYER);
+        return grid.any(walls | layerBit(BODY_LAYER) | layerBit(HAZARD_LAYER), c.x, c.y);
+    }
+
+    // Greedy bot: the safe turn that gets closest to the nearest fruit,
+    // keeping its heading on ties. With no safe turn it carries on and dies.
+    void steerBot(Snake& s) {
+        Cell head = s.body.front();
+        Fruit goal;
+        bool hasGoal = fruits.nearest(head.x, head.y, 1, &goal, settings.wrapAround) > 0;
+        Direction best = s.dir;
+        int bestDist = INT_MAX;
+        for (int d = UP; d <= RIGHT; d++) {
+            if (d == OPPOSITE[s.dir]) continue;
+            Cell c;
+            if (stepBlocked(head, (Direction)d, s, c)) continue;
+            int dist = hasGoal ? distance(c, goal.x, goal.y) : 0;
+            if (dist < bestDist || (dist == bestDist && d == s.dir)) {
+                best = (Direction)d;
+                bestDist = dist;
+            }
+        }
+        s.dir = best;
+    }
+
+    int distance(Cell c, int x, int y) const {
+        int dx = abs(c.x - x), dy = abs(c.y - y);
+        if (settings.wrapAround) {
+            dx = std::min(dx, settings.width - dx);
+            dy = std::min(dy, settings.height - dy);
+        }
+        return dx + dy;
+    }
+
+    // A dead snake is taken off the board so the others can keep playing
+    void kill(Snake& s) {
+        record(SNAKE_DIED, (int)(&s - &snakes[0]));
+        s.alive = false;
+        s.dir = STOP;
+        for (const Cell& c : s.body) {
+            grid.reset(BODY_LAYER, c.x, c.y);
+        }
+        s.body.clear();
+    }
+
+    // Puts a fruit on a random free cell (of the map's fruit zones, if it has
+    // any); false if there is none
+    bool spawnFruit() {
+        TRACE_SPAN("spawnFruit");
+        Fruit newFruit;
+        int attempts = 0;
+        bool zoned = settings.map && settings.map->hasFruitZones();
+        while (attempts < 100) {
+            if (zoned) {
+                settings.map->zoneCell(rng.next(), newFruit.x, newFruit.y);
+            } else {
+                newFruit.x = rng.below(settings.width);
+                newFruit.y = rng.below(settings.height);
+            }
+            if (fruitFits(newFruit.x, newFruit.y)) {
+                int chance = rng.below(100);
+                newFruit.type = (chance < 15) ? SLOW : NORMAL; // 20% green, 80% red
+                if (settings.powerUps && rng.below(100) < POWER_UP_PERCENT) newFruit.type = (FruitType)(GHOST_FRUIT + rng.below(EFFECT_COUNT));
+                newFruit.expiresAt = lifetimeEnd(newFruit.type);
+                addFruit(newFruit);
+                scheduleExpiry(newFruit);
+                return true;
+            }
+            attempts++;
+        }
+        // A crowded board: the first free cell from the middle on, in
+        // reading order
+        if (!crowdedCell(zoned, newFruit.x, newFruit.y)) return false;
+        newFruit.type = NORMAL;
+        newFruit.expiresAt = lifetimeEnd(NORMAL);
+        addFruit(newFruit);
+        scheduleExpiry(newFruit);
+        return true;
+    }
+
+    bool fruitFits(int x, int y) const {
+        return !grid.any(layerBit(OBSTACLE_LAYER) | layerBit(BODY_LAYER) | layerBit(FRUIT_LAYER) | layerBit(HAZARD_LAYER) | layerBit(PORTAL_LAYER), x, y);
+    }
+
+    bool crowdedCell(bool zoned, int& x, int& y) const {
+        long long cells = zoned ? (long long)settings.map->zoneSize() : (long long)settings.width * settings.height;
+        long long from = zoned ? cells / 2 : (long long)(settings.height / 2) * settings.width + settings.width / 2;
+        for (long long k = 0; k < cells; k++) {
+            long long at = (from + k) % cells;
+            if (zoned) {
+                settings.map->zoneCell(at, x, y);
+            } else {
+                x = at % settings.width;
+                y = at / settings.width;
+            }
+            if (fruitFits(x, y)) return true;
+        }
+        return false;
+    }
+
+    // Power-ups always run out; other fruits only with a lifetime set
+    long long lifetimeEnd(FruitType type) const {
+        if (type >= GHOST_FRUIT) return clock + (long long)POWER_UP_FRUIT_TICKS * EFFECT_TICK;
+        if (settings.fruitLifetime) return clock + (long long)settings.fruitLifetime * EFFECT_TICK;
+        return 0;
+    }
+
+    // Timers are keyed by cell and never cancelled: an eaten fruit's timer
+    // finds another fruit or none there when it fires, and is ignored
+    void scheduleExpiry(const Fruit& fruit) {
+        if (!fruit.expiresAt) return;
+        expiries.schedule((uint64_t)fruit.y * settings.width + fruit.x, (fruit.expiresAt + EFFECT_TICK - 1) / EFFECT_TICK);
+    }
+
+    // Takes off the fruits whose time ran out by this phase; returns how many
+    int expireFruits() {
+        expired.clear();
+        expiries.advance(clock / EFFECT_TICK, [this](uint64_t cell, long long) { expired.push_back(cell); });
+        if (expired.empty()) return 0;
+        // The wheel's order depends on its history, which a restored game
+        // doesn't share; removals must come out the same everywhere
+        std::sort(expired.begin(), expired.end());
+        int count = 0;
+        for (uint64_t cell : expired) {
+            int x = cell % settings.width, y = cell / settings.width;
+            const Fruit* fruit = isFruit(x, y) ? fruits.find(x, y) : nullptr;
+            if (fruit && fruit->expiresAt && fruit->expiresAt <= clock) {
+                removeFruit(x, y);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    void addFruit(const Fruit& fruit) {
+        record(FRUIT_ADDED, 0, STOP, 0, fruit);
+        fruits.insert(fruit);
+        grid.set(FRUIT_LAYER, fruit.x, fruit.y);
+    }
+
+    void removeFruit(int x, int y) {
+        record(FRUIT_REMOVED, 0, STOP, 0, *fruits.find(x, y));
+        fruits.erase(x, y);
+        grid.reset(FRUIT_LAYER, x, y);
+    }
+
+    // Lays out the level before the fruits: the map's walls, a level from the
+    // pack, or a generated one keeping every start zone clear and every free
+    // cell reachable
+    void spawnObstacles() {
+        if (settings.map) {
+            placeObstacleRows(settings.map->wallRows(), settings.map->wordsPerRow());
+            return;
+        }
+        if (!settings.enableObstacles) return; // Skip if obstacles are disabled
+        const LevelPack* pack = settings.levels;
+        if (pack && pack->fits(settings.width, settings.height, settings.snakes, settings.wrapAround)) {
+            size_t pick = rng.next() % pack->size();
+            placeObstacleRows(pack->wallRows(pick), pack->getHeader().wordsPerRow);
+            return;
+        }
+        if ((long long)settings.width * settings.height > MAX_LEVEL_CELLS) {
+            scatterObstacles();
+            return;
+        }
+        level.begin(settings.width, settings.height, settings.wrapAround);
+        for (const Snake& s : snakes) keepStartClear(level, s.body.front());
+        level.generate(settings.level, settings.obstacles, rng);
+        placeObstacleRows(level.getBits().data(), (settings.width + 63) / 64);
+    }
+
+    // Copies a wall bitboard into the grid a 64-cell word at a time
+    void placeObstacleRows(const uint64_t* rows, int wordsPerRow) {
+        for (int y = 0; y < settings.height; y++) {
+            for (int w = 0; w < wordsPerRow; w++) grid.setBits(OBSTACLE_LAYER, y, w, rows[(size_t)y * wordsPerRow + w]);
+        }
+    }
+
+    // Boards too big to validate cell by cell get scattered blocks only, each
+    // clear of the others and of the edge so none can close anything off
+    void scatterObstacles() {
+        int numObstacles = settings.obstacles ? settings.obstacles : 8 + rng.below(25);
+        for (int i = 0; i < numObstacles; i++) {
+            int attempt = 0;
+            for (; attempt < 100; attempt++) {
+                int x = 1 + rng.below(settings.width - 2), y = 1 + rng.below(settings.height - 2);
+                if (nearStart(x, y) || grid.test(OBSTACLE_LAYER, x - 1, y - 1) || grid.test(OBSTACLE_LAYER, x, y - 1) ||
+                    grid.test(OBSTACLE_LAYER, x + 1, y - 1) || grid.test(OBSTACLE_LAYER, x - 1, y) || grid.test(OBSTACLE_LAYER, x + 1, y) ||
+                    grid.test(OBSTACLE_LAYER, x - 1, y + 1) || grid.test(OBSTACLE_LAYER, x, y + 1) || grid.test(OBSTACLE_LAYER, x + 1, y + 1)) continue;
+                grid.set(OBSTACLE_LAYER, x, y);
+                break;
+            }
+            if (attempt == 100) break; // no room for more; however many were asked for
+        }
+    }
+
+    // Both ends of a portal pair go on free cells away from the start zones;
+    // once a pair can't be placed, no more are tried
+    void spawnPortals() {
+        for (int i = 0; i < settings.portals; i++) {
+            Cell ends[2];
+            int found = 0;
+            for (int attempt = 0; attempt < 200 && found < 2; attempt++) {
+                Cell c = { rng.below(settings.width), rng.below(settings.height) };
+                if (nearStart(c.x, c.y) || grid.any(layerBit(OBSTACLE_LAYER) | layerBit(PORTAL_LAYER), c.x, c.y)) continue;
+                grid.set(PORTAL_LAYER, c.x, c.y);
+                ends[found++] = c;
+            }
+            if (found < 2) {
+                if (found) grid.reset(PORTAL_LAYER, ends[0].x, ends[0].y);
+                break;
+            }
+            for (int k = 0; k < 2; k++) {
+                Entity e = entities.pool.create();
+                entities.position.add(e, ends[k]);
+                entities.exit.add(e, ends[1 - k]);
+            }
+        }
+    }
+
+    // Hazards start on free cells away from the start zones; a patrol's path
+    // runs from there along a row or column for as far as that holds, up to
+    // PATROL_MAX_LENGTH cells. Once one can't be placed, no more are tried.
+    void spawnHazards() {
+        for (int i = 0; i < settings.hazards; i++) {
+            int attempt = 0;
+            for (; attempt < 100; attempt++) {
+                Cell c = { rng.below(settings.width), rng.below(settings.height) };
+                if (nearStart(c.x, c.y) || grid.any(layerBit(OBSTACLE_LAYER) | layerBit(HAZARD_LAYER) | layerBit(PORTAL_LAYER), c.x, c.y)) continue;
+                Motion m = {};
+                if (i % 2 == 0) {
+                    bool vertical = rng.below(2);
+                    m.dx = !vertical;
+                    m.dy = vertical;
+                    m.heading = 1;
+                    Cell at = c;
+                    while (m.patrolLength < PATROL_MAX_LENGTH) {
+                        at = shifted(at, m.dx, m.dy);
+                        if (offBoard(at) || nearStart(at.x, at.y) || grid.any(layerBit(OBSTACLE_LAYER) | layerBit(PORTAL_LAYER), at.x, at.y)) break;
+                        m.patrolLength++;
+                    }
+                } else {
+                    m.dx = rng.below(2) ? 1 : -1;
+                    m.dy = rng.below(2) ? 1 : -1;
+                }
+                Entity e = entities.pool.create();
+                entities.position.add(e, c);
+                entities.motion.add(e, m);
+                grid.set(HAZARD_LAYER, c.x, c.y);
+                break;
+            }
+            if (attempt == 100) break;
+        }
+    }
+
+    // Catches the hazards up with the clock, one step per effect tick, in
+    // entity order; each sees the ones before it in their new cells. The
+    // cost is linear in hazards: the grid is only touched at their cells.
+    void moveHazards() {
+        long long tick = clock / EFFECT_TICK;
+        if (entities.motion.size() == 0) {
+            entities.movedTick = tick;
+            return;
+        }
+        for (; entities.movedTick < tick; entities.movedTick++) {
+            for (size_t i = 0; i < entities.motion.size(); i++) {
+                Motion& m = entities.motion[i];
+                Cell& at = entities.position.get(entities.motion.owner(i));
+                Cell next;
+                if (m.patrolLength) {
+                    int along = m.patrolAt + m.heading;
+                    next = shifted(at, m.dx * m.heading, m.dy * m.heading);
+                    if (along < 0 || along > m.patrolLength || hazardBlocked(next)) {
+                        m.heading = -m.heading; // turns back now, steps next tick
+                        continue;
+                    }
+                    m.patrolAt = along;
+                } else {
+                    next = shifted(at, m.dx, m.dy);
+                    if (hazardBlocked(next)) {
+                        // Reflect off one axis if that frees the way, else go straight back
+                        if (!hazardBlocked(shifted(at, -m.dx, m.dy))) {
+                            m.dx = -m.dx;
+                        } else if (!hazardBlocked(shifted(at, m.dx, -m.dy))) {
+                            m.dy = -m.dy;
+                        } else {
+                            m.dx = -m.dx;
+                            m.dy = -m.dy;
+                        }
+                        next = shifted(at, m.dx, m.dy);
+                        if (hazardBlocked(next)) continue; // boxed in for now
+                    }
+                }
+                grid.reset(HAZARD_LAYER, at.x, at.y);
+                at = next;
+                grid.set(HAZARD_LAYER, at.x, at.y);
+            }
+        }
+    }
+
+    // Moved by (dx, dy); off-board cells are left as they are unless wrapping
+    Cell shifted(Cell c, int dx, int dy) const {
+        Cell n = { c.x + dx, c.y + dy };
+        if (settings.wrapAround) {
+            n.x = wrapCoord(n.x, settings.width);
+            n.y = wrapCoord(n.y, settings.height);
+        }
+        return n;
+    }
+
+    bool offBoard(Cell c) const { return c.x < 0 || c.x >= settings.width || c.y < 0 || c.y >= settings.height; }
+
+    // Hazards don't enter walls, bodies, portals or each other; they pass
+    // over fruit
+    bool hazardBlocked(Cell c) const {
+        return offBoard(c) || grid.any(layerBit(OBSTACLE_LAYER) | layerBit(BODY_LAYER) | layerBit(HAZARD_LAYER) | layerBit(PORTAL_LAYER), c.x, c.y);
+    }
+
+    bool nearStart(int x, int y) const {
+        for (const Snake& s : snakes) {
+            Cell head = s.body.front();
+            if (x >= head.x - 3 && x <= head.x + START_CLEAR_AHEAD && abs(y - head.y) <= START_CLEAR_SIDE) return true;
+        }
+        return false;
+    }
+};
+
+#endif
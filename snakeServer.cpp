@@ -0,0 +1,895 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unistd.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/resource.h>
+#include "snakeCore.h"
+#include "netProtocol.h"
+#include "timerWheel.h"
+#include "tracer.h"
+
+using namespace std;
+
+// Authoritative multi-room game server. One acceptor thread hands each new
+// connection to a worker; a worker owns its connections and rooms outright
+// (no locks on the game path), multiplexes them with its own epoll, and ticks
+// every room on that room's own schedule through a timer wheel.
+
+const long long WHEEL_RESOLUTION = 1000; // 1ms slots
+const int WHEEL_SLOTS = 4096;
+const size_t MAX_OUTPUT = 1 << 20;       // a client this far behind is dropped
+const size_t MAX_BACKLOG = 64 << 10;     // past this, game frames are skipped up to the next keyframe
+const int MAX_IOVECS = 64;               // frames handed to one sendmsg
+const int MAX_CATCH_UP = 4;              // phases a late room may run back to back
+const int KEYFRAME_INTERVAL = 100;       // ticks between full states; deltas in between
+
+long long nowMicros() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ServerConfig {
+    int port = DEFAULT_PORT;
+    int workers = 0;        // 0 = one per core
+    GameSettings settings;  // humans = seats per room, the rest are bots
+    uint64_t seed = 0;      // each worker's room seeds are drawn from seed + its index
+};
+
+// Counters a worker bumps and the stats printer reads; relaxed is enough
+struct WorkerStats {
+    atomic<long long> connections{0};
+    atomic<long long> spectators{0};
+    atomic<long long> rooms{0};
+    atomic<long long> roomsOpened{0};
+    atomic<long long> roomsFinished{0};
+    atomic<long long> ticks{0};
+    atomic<long long> lateTotal{0};  // microseconds ticks ran after their due time
+    atomic<long long> lateMax{0};
+    atomic<long long> overruns{0};   // ticks more than one wheel slot late
+    atomic<long long> bytesOut{0};
+    atomic<long long> framesSkipped{0}; // frames a lagging client never got
+};
+
+// One encoded message, shared by every connection it is queued on, so a
+// room's tick is serialised once however many players and spectators it has
+struct Frame {
+    string data;
+    bool resync;     // holds a full board: a lagging client can pick up from here
+    bool droppable;  // STATE and DELTA; WELCOME and GAME_OVER always arrive
+};
+typedef shared_ptr<const Frame> FramePtr;
+
+FramePtr makeFrame(string& data, bool resync, bool droppable) {
+    shared_ptr<Frame> frame = make_shared<Frame>();
+    frame->data.swap(data);
+    frame->resync = resync;
+    frame->droppable = droppable;
+    return frame;
+}
+
+struct Room;
+
+struct Connection {
+    int fd;
+    string in;
+    deque<FramePtr> out;   // front() may be partly written already
+    size_t outOffset;      // bytes of out.front() already sent
+    size_t outBytes;       // unsent bytes across the queue
+    bool skipping;         // dropping game frames until the next keyframe
+    string name;
+    Room* room;
+    int slot;              // snake index, or index in room->spectators
+    bool spectating;
+    bool wantsWrite;
+};
+
+struct Room {
+    uint32_t id;
+    GameCore core;
+    vector<Connection*> seats; // by snake index; bots and leavers are null
+    int joined;
+    int connected;
+    bool running;
+    long long startReal;       // wall clock of game clock 0
+    uint64_t generation;       // stale wheel entries carry an older one
+    vector<string> names;
+    vector<Connection*> spectators; // closed ones are nulled, then compacted before a broadcast
+    int closedSpectators;
+    int ticksSinceKeyframe;
+    vector<uint32_t> inputSeq; // per seat: last input sequence number applied
+    vector<uint32_t> ackedSeq; // per seat: last one acknowledged in a frame
+};
+
+// A connection moving to the worker that owns the room it wants to watch,
+// or the one whose room its seat is in
+struct Handoff {
+    int fd;
+    uint32_t watchRoom;        // 0 for a fresh connection
+    bool joining;              // seat it as soon as it arrives
+    string name;               // from its JOIN
+};
+
+class Worker {
+public:
+    Worker(int index, const ServerConfig& config, const vector<Worker*>& peers, atomic<uint64_t>& seatsDealt)
+        : index(index), config(config), peers(peers), seatsDealt(seatsDealt), wheel(WHEEL_RESOLUTION, WHEEL_SLOTS), filling(nullptr),
+          nextRoomId(index + config.workers), lastStarted(0), stopping(false) {
+        rng.state = config.seed + index;
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) {
+            perror("worker");
+            exit(1);
+        }
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr; // null marks the wake-up eventfd
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    }
+
+    void start() { thread = std::thread(&Worker::run, this); }
+
+    void stop() {
+        stopping = true;
+        wake();
+        thread.join();
+    }
+
+    // Called from the acceptor thread, and from other workers passing on a spectator
+    void hand(int fd, uint32_t watchRoom = 0, bool joining = false, const string& name = string()) {
+        {
+            lock_guard<mutex> lock(incomingLock);
+            incoming.push_back(Handoff{ fd, watchRoom, joining, name });
+        }
+        wake();
+    }
+
+    WorkerStats stats;
+
+private:
+    int index;
+    const ServerConfig& config;
+    const vector<Worker*>& peers; // room ids are index + k * workers, so id % workers finds the owner
+    atomic<uint64_t>& seatsDealt; // shared by all workers, see seat()
+    int epollFd, wakeFd;
+    std::thread thread;
+    mutex incomingLock;
+    vector<Handoff> incoming;
+    TimerWheel wheel;
+    unordered_map<uint32_t, Room*> rooms;
+    unordered_map<int, Connection*> connections;
+    vector<Connection*> graveyard;
+    vector<uint32_t> emptyRooms;
+    Room* filling;          // room still waiting for players
+    uint32_t nextRoomId;
+    uint32_t lastStarted;   // where WATCH 0 sends a spectator
+    GameRng rng;            // this thread's own, so rooms don't share rand()'s state
+    atomic<bool> stopping;
+
+    void wake() {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {} // counter can't overflow in practice
+    }
+
+    void run() {
+        Tracer::instance().nameThread("worker " + to_string(index));
+        wheel.start(nowMicros());
+        struct epoll_event events[256];
+        while (!stopping) {
+            // Connections closed during the previous pass can go now that no
+            // event still points at them
+            for (Connection* dead : graveyard) delete dead;
+            graveyard.clear();
+
+            long long timeout = wheel.timeout(nowMicros());
+            int n;
+            {
+                TRACE_SPAN("sleep");
+                n = epoll_wait(epollFd, events, 256, timeout < 0 ? -1 : (int)((timeout + 999) / 1000));
+            }
+            for (int i = 0; i < n; i++) {
+                Connection* c = (Connection*)events[i].data.ptr;
+                if (!c) {
+                    uint64_t count;
+                    if (read(wakeFd, &count, sizeof(count)) < 0) {}
+                    adoptIncoming();
+                    continue;
+                }
+                if (c->fd < 0) continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    closeConnection(c);
+                    continue;
+                }
+                if ((events[i].events & EPOLLOUT) && !flush(c)) continue;
+                if (events[i].events & EPOLLIN) readFrom(c);
+            }
+            wheel.advance(nowMicros(), [this](uint64_t id, long long due) { tick(id, due); });
+            closeEmptyRooms();
+        }
+
+        vector<Room*> left;
+        for (auto& entry : rooms) left.push_back(entry.second);
+        for (Room* room : left) closeRoom(room, false);
+        for (auto& entry : connections) {
+            if (entry.second->fd >= 0) close(entry.second->fd);
+            delete entry.second;
+        }
+        for (Connection* dead : graveyard) delete dead;
+    }
+
+    // Rooms whose last player left; closed outside any loop over their seats
+    void closeEmptyRooms() {
+        vector<uint32_t> ids;
+        ids.swap(emptyRooms);
+        for (uint32_t id : ids) {
+            auto it = rooms.find(id);
+            if (it != rooms.end()) closeRoom(it->second, false);
+        }
+    }
+
+    void adoptIncoming() {
+        vector<Handoff> handoffs;
+        {
+            lock_guard<mutex> lock(incomingLock);
+            handoffs.swap(incoming);
+        }
+        for (const Handoff& h : handoffs) {
+            Connection* c = new Connection();
+            c->fd = h.fd;
+            c->outOffset = 0;
+            c->outBytes = 0;
+            c->skipping = false;
+            c->room = nullptr;
+            c->slot = -1;
+            c->spectating = false;
+            c->wantsWrite = false;
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.ptr = c;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, h.fd, &ev);
+            connections[h.fd] = c;
+            stats.connections++;
+            if (h.joining) {
+                c->name = h.name;
+                join(c);
+            } else if (h.watchRoom) {
+                watch(c, h.watchRoom, false);
+            }
+        }
+    }
+
+    void readFrom(Connection* c) {
+        TRACE_SPAN("read");
+        char buf[4096];
+        while (true) {
+            ssize_t got = read(c->fd, buf, sizeof(buf));
+            if (got > 0) {
+                c->in.append(buf, got);
+                continue;
+            }
+            if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                closeConnection(c);
+                return;
+            }
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        size_t pos = 0;
+        uint8_t type;
+        const char* payload;
+        size_t size;
+        bool bad = false;
+        while (nextMessage(c->in, pos, type, payload, size, bad)) {
+            MessageReader r(payload, size);
+            if (type == MSG_JOIN) {
+                c->name = r.str();
+                // A player handed to another worker is gone from this one
+                if (r.good() && !c->room && !seat(c)) return;
+            } else if (type == MSG_INPUT) {
+                int d = r.u8();
+                uint32_t seq = r.remaining() >= 4 ? r.u32() : 0;
+                if (r.good() && c->room && !c->spectating && c->room->running && d >= UP && d <= RIGHT) {
+                    c->room->core.steer(c->slot, (Direction)d);
+                    c->room->inputSeq[c->slot] = seq;
+                }
+            } else if (type == MSG_WATCH) {
+                uint32_t id = r.u32();
+                // A spectator handed to another worker is gone from this one
+                if (r.good() && !c->room && !watch(c, id, true)) return;
+            }
+        }
+        if (bad) {
+            closeConnection(c);
+            return;
+        }
+        c->in.erase(0, pos);
+    }
+
+    // Seats are dealt in JOIN order, one room's worth at a time, and all of a
+    // room's seats go to one worker; spectators and clients that never join
+    // don't shift the count, so every room fills on one worker. Returns false
+    // when c was passed on to that worker.
+    bool seat(Connection* c) {
+        uint64_t dealt = seatsDealt.fetch_add(1, memory_order_relaxed);
+        int owner = (dealt / config.settings.humans) % config.workers;
+        if (owner == index) {
+            join(c);
+            return true;
+        }
+        handOff(c, owner, 0, true);
+        return false;
+    }
+
+    // Seats the connection in the room being filled, starting it when full
+    void join(Connection* c) {
+        if (!filling) {
+            Room* room = new Room();
+            room->id = nextRoomId;
+            nextRoomId += config.workers;
+            room->core = GameCore(config.settings);
+            room->core.reset(rng.next());
+            room->core.recordChanges(true);
+            room->seats.assign(config.settings.snakes, nullptr);
+            room->joined = 0;
+            room->connected = 0;
+            room->running = false;
+            room->generation = 0;
+            room->closedSpectators = 0;
+            room->ticksSinceKeyframe = 0;
+            room->inputSeq.assign(config.settings.snakes, 0);
+            room->ackedSeq.assign(config.settings.snakes, 0);
+            for (int i = 0; i < config.settings.snakes; i++) room->names.push_back("Bot " + to_string(i + 1));
+            rooms[room->id] = room;
+            filling = room;
+            stats.rooms++;
+            stats.roomsOpened++;
+        }
+        Room* room = filling;
+        c->room = room;
+        c->slot = room->joined;
+        room->seats[c->slot] = c;
+        room->names[c->slot] = c->name.empty() ? "Player " + to_string(c->slot + 1) : c->name;
+        room->joined++;
+        room->connected++;
+        if (room->joined == config.settings.humans) {
+            filling = nullptr;
+            startRoom(room);
+        }
+    }
+
+    void startRoom(Room* room) {
+        room->running = true;
+        room->startReal = nowMicros();
+        room->core.start();
+        for (int i = 0; i < config.settings.humans; i++) room->core.steer(i, RIGHT);
+        room->core.clearChanges();
+        lastStarted = room->id;
+
+        for (Connection* c : room->seats) {
+            if (c) welcome(c, room);
+        }
+        for (size_t i = 0; i < room->spectators.size(); i++) {
+            if (room->spectators[i]) welcome(room->spectators[i], room);
+        }
+        schedule(room);
+    }
+
+    vector<InputAck> allAcks(Room* room) {
+        vector<InputAck> acks;
+        for (int i = 0; i < (int)room->inputSeq.size(); i++) acks.push_back(InputAck{ (uint8_t)i, room->inputSeq[i] });
+        return acks;
+    }
+
+    // WELCOME plus a keyframe, for a player at the start or a spectator at any time
+    void welcome(Connection* c, Room* room) {
+        string msg;
+        MessageWriter w(msg);
+        w.begin(MSG_WELCOME);
+        w.u32(room->id);
+        w.u8(c->spectating ? SPECTATOR_SLOT : c->slot);
+        writeSettings(w, room->core.getSettings());
+        for (const string& name : room->names) w.str(name);
+        w.end();
+        writeState(msg, room->core, allAcks(room));
+        send(c, makeFrame(msg, true, false));
+    }
+
+    // Adds a spectator to a room: 0 picks the most recently started one. A
+    // room owned by another worker gets the connection passed on; returns
+    // false when that happened and c is no longer this worker's.
+    bool watch(Connection* c, uint32_t id, bool mayForward) {
+        int owner = id % config.workers;
+        if (id && owner != index && mayForward) {
+            handOff(c, owner, id);
+            return false;
+        }
+        auto it = rooms.find(id ? id : lastStarted);
+        Room* room = it != rooms.end() ? it->second : nullptr;
+        if (!id && !room) {
+            for (auto& entry : rooms) {
+                if (entry.second->running) room = entry.second;
+            }
+            if (!room) room = filling;
+        }
+        if (!room) {
+            // Nothing to watch: an empty GAME_OVER sends the client back
+            string msg;
+            MessageWriter w(msg);
+            w.begin(MSG_GAME_OVER);
+            w.u8(0);
+            w.end();
+            send(c, makeFrame(msg, false, false));
+            return true;
+        }
+        c->room = room;
+        c->spectating = true;
+        c->slot = room->spectators.size();
+        room->spectators.push_back(c);
+        stats.spectators++;
+        if (room->running) welcome(c, room);
+        return true;
+    }
+
+    void handOff(Connection* c, int owner, uint32_t id, bool joining = false) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, nullptr);
+        connections.erase(c->fd);
+        stats.connections--;
+        int fd = c->fd;
+        c->fd = -1;
+        graveyard.push_back(c);
+        peers[owner]->hand(fd, id, joining, c->name);
+    }
+
+    // Queues one encoded frame on every player and spectator of a room
+    void broadcast(Room* room, const FramePtr& frame) {
+        TRACE_SPAN("broadcast");
+        if (room->closedSpectators) {
+            vector<Connection*>& list = room->spectators;
+            size_t kept = 0;
+            for (size_t i = 0; i < list.size(); i++) {
+                if (!list[i]) continue;
+                list[i]->slot = kept;
+                list[kept++] = list[i];
+            }
+            list.resize(kept);
+            room->closedSpectators = 0;
+        }
+        for (Connection* c : room->seats) {
+            if (c) send(c, frame);
+        }
+        // Indexed: a spectator dropped mid-loop only nulls its entry
+        for (size_t i = 0; i < room->spectators.size(); i++) {
+            if (room->spectators[i]) send(room->spectators[i], frame);
+        }
+    }
+
+    void schedule(Room* room) {
+        long long due = room->core.nextMoveTime();
+        if (due < 0) return;
+        wheel.schedule(((uint64_t)room->id << 24) | (room->generation & 0xFFFFFF), room->startReal + due);
+    }
+
+    void tick(uint64_t id, long long due) {
+        TRACE_SPAN("tick");
+        auto it = rooms.find((uint32_t)(id >> 24));
+        if (it == rooms.end()) return;
+        Room* room = it->second;
+        if (!room->running || (room->generation & 0xFFFFFF) != (id & 0xFFFFFF)) return;
+        room->generation++;
+
+        long long now = nowMicros();
+        long long late = now - due;
+        stats.ticks++;
+        stats.lateTotal += late;
+        if (late > stats.lateMax) stats.lateMax = late;
+        if (late > WHEEL_RESOLUTION) stats.overruns++;
+
+        // A room that fell behind catches up a few phases, then carries on late
+        for (int i = 0; i < MAX_CATCH_UP; i++) {
+            room->core.stepPhase();
+            long long next = room->core.nextMoveTime();
+            if (room->core.isOver() || next < 0 || room->startReal + next > now) break;
+        }
+
+        // Deltas carry the change journal; a periodic keyframe resynchronises
+        string msg;
+        bool keyframe = ++room->ticksSinceKeyframe >= KEYFRAME_INTERVAL;
+        if (keyframe) {
+            writeState(msg, room->core, allAcks(room));
+            room->ticksSinceKeyframe = 0;
+        } else {
+            // Only seats with new input are acknowledged
+            vector<InputAck> acks;
+            for (int i = 0; i < (int)room->inputSeq.size(); i++) {
+                if (room->inputSeq[i] != room->ackedSeq[i]) acks.push_back(InputAck{ (uint8_t)i, room->inputSeq[i] });
+            }
+            writeDelta(msg, room->core.getChanges(), acks);
+        }
+        room->ackedSeq = room->inputSeq;
+        room->core.clearChanges();
+        broadcast(room, makeFrame(msg, keyframe, true));
+        if (room->core.isOver()) {
+            closeRoom(room, true);
+            return;
+        }
+        schedule(room);
+    }
+
+    // Ends a room; players go back to the lobby and may JOIN again, and
+    // spectators are told the game is over either way
+    void closeRoom(Room* room, bool finished) {
+        string msg;
+        MessageWriter w(msg);
+        w.begin(MSG_GAME_OVER);
+        const vector<Snake>& snakes = room->core.getSnakes();
+        w.u8(snakes.size());
+        for (const Snake& s : snakes) w.i32(s.score);
+        w.end();
+        FramePtr frame = makeFrame(msg, false, false);
+        if (finished) {
+            for (Connection* c : room->seats) {
+                if (c) send(c, frame);
+            }
+            stats.roomsFinished++;
+        }
+        for (size_t i = 0; i < room->spectators.size(); i++) {
+            if (room->spectators[i]) send(room->spectators[i], frame);
+        }
+        for (Connection* c : room->seats) {
+            if (c) c->room = nullptr;
+        }
+        for (Connection* c : room->spectators) {
+            if (!c) continue;
+            c->room = nullptr;
+            c->spectating = false;
+            stats.spectators--;
+        }
+        if (filling == room) filling = nullptr;
+        rooms.erase(room->id);
+        stats.rooms--;
+        delete room;
+    }
+
+    // Queues a frame and writes what the socket takes. A client that can't
+    // keep up loses its unsent game frames and gets nothing more until the
+    // next keyframe, so a slow reader costs a bounded backlog instead of
+    // buffering every tick; only control messages can push it past MAX_OUTPUT.
+    void send(Connection* c, const FramePtr& frame) {
+        if (c->skipping && !frame->resync && frame->droppable) {
+            stats.framesSkipped++;
+            return;
+        }
+        if (c->outBytes > MAX_BACKLOG && frame->droppable) {
+            dropBacklog(c);
+            c->skipping = true;
+            if (!frame->resync) {
+                stats.framesSkipped++;
+                return;
+            }
+        }
+        if (c->outBytes + frame->data.size() > MAX_OUTPUT) {
+            closeConnection(c);
+            return;
+        }
+        if (frame->resync) c->skipping = false;
+        c->out.push_back(frame);
+        c->outBytes += frame->data.size();
+        flush(c);
+    }
+
+    // Forgets the queued game frames nothing has been written of yet
+    void dropBacklog(Connection* c) {
+        deque<FramePtr> kept;
+        for (size_t i = 0; i < c->out.size(); i++) {
+            const FramePtr& frame = c->out[i];
+            if ((i == 0 && c->outOffset > 0) || !frame->droppable) {
+                kept.push_back(frame);
+                continue;
+            }
+            c->outBytes -= frame->data.size();
+            stats.framesSkipped++;
+        }
+        c->out.swap(kept);
+    }
+
+    // Writes what the socket takes, many frames per sendmsg; returns false
+    // if the connection was closed
+    bool flush(Connection* c) {
+        while (!c->out.empty()) {
+            struct iovec iov[MAX_IOVECS];
+            int count = 0;
+            for (size_t i = 0; i < c->out.size() && count < MAX_IOVECS; i++, count++) {
+                const string& data = c->out[i]->data;
+                size_t skip = i == 0 ? c->outOffset : 0;
+                iov[count].iov_base = (void*)(data.data() + skip);
+                iov[count].iov_len = data.size() - skip;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t sent = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (sent <= 0) {
+                closeConnection(c);
+                return false;
+            }
+            stats.bytesOut += sent;
+            c->outBytes -= sent;
+            size_t left = sent;
+            while (left > 0) {
+                size_t rest = c->out.front()->data.size() - c->outOffset;
+                if (left < rest) {
+                    c->outOffset += left;
+                    break;
+                }
+                left -= rest;
+                c->out.pop_front();
+                c->outOffset = 0;
+            }
+        }
+        bool want = !c->out.empty();
+        if (want != c->wantsWrite) {
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN | (want ? (uint32_t)EPOLLOUT : 0u);
+            ev.data.ptr = c;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, c->fd, &ev);
+            c->wantsWrite = want;
+        }
+        return true;
+    }
+
+    // Can run in the middle of a room broadcast, so the room itself and the
+    // Connection object are only released later
+    void closeConnection(Connection* c) {
+        if (c->fd < 0) return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, nullptr);
+        connections.erase(c->fd);
+        close(c->fd);
+        c->fd = -1;
+        stats.connections--;
+        Room* room = c->room;
+        if (room && c->spectating) {
+            room->spectators[c->slot] = nullptr;
+            room->closedSpectators++;
+            c->room = nullptr;
+            stats.spectators--;
+        } else if (room) {
+            // The snake keeps going straight; an empty room is shut down
+            room->seats[c->slot] = nullptr;
+            room->connected--;
+            c->room = nullptr;
+            if (room->connected == 0) {
+                room->running = false;
+                if (filling == room) filling = nullptr;
+                emptyRooms.push_back(room->id);
+            }
+        }
+        graveyard.push_back(c);
+    }
+};
+
+int listenOn(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4096) < 0) {
+        perror("listen");
+        exit(1);
+    }
+    return fd;
+}
+
+// Lifts the open-file limit to the hard maximum so thousands of sockets fit
+void raiseFileLimit() {
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+}
+
+// Usage: snakeServer [--port N] [--workers N] [--players N] [--bots N] [--board WxH] [--fruits N] [--obstacles N] [--level STYLE] [--levels PACK] [--map FILE] [--power-ups] [--fruit-life N] [--hazards N] [--portals N] [--wrap] [--no-obstacles] [--seed N] [--trace FILE]
+int main(int argc, char* argv[]) {
+    ServerConfig config;
+    config.settings.humans = 1;
+    config.seed = time(0);
+    LevelPack levels;
+    LevelMap map;
+    int bots = 0;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            config.port = atoi(argv[++i]);
+        } else if (arg == "--workers" && i + 1 < argc) {
+            config.workers = max(1, atoi(argv[++i]));
+        } else if (arg == "--players" && i + 1 < argc) {
+            config.settings.humans = max(1, min(MAX_SNAKES, atoi(argv[++i])));
+        } else if (arg == "--bots" && i + 1 < argc) {
+            bots = max(0, atoi(argv[++i]));
+        } else if (arg == "--board" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &config.settings.width, &config.settings.height) != 2 ||
+                config.settings.width < 5 || config.settings.height < 1 ||
+                config.settings.width > 65535 || config.settings.height > 65535) {
+                cerr << "--board expects WxH between 5x1 and 65535x65535" << endl;
+                return 1;
+            }
+        } else if (arg == "--wrap") {
+            config.settings.wrapAround = true;
+        } else if (arg == "--fruits" && i + 1 < argc) {
+            config.settings.fruits = max(1, atoi(argv[++i]));
+        } else if (arg == "--obstacles" && i + 1 < argc) {
+            config.settings.obstacles = max(1, atoi(argv[++i]));
+        } else if (arg == "--level" && i + 1 < argc) {
+            if (!parseLevelStyle(argv[++i], config.settings.level)) {
+                cerr << "--level expects scatter, walls, rooms or maze" << endl;
+                return 1;
+            }
+        } else if (arg == "--levels" && i + 1 < argc) {
+            if (!levels.open(argv[++i])) return 1;
+            config.settings.levels = &levels;
+        } else if (arg == "--map" && i + 1 < argc) {
+            if (!map.open(argv[++i])) return 1;
+        } else if (arg == "--power-ups") {
+            config.settings.powerUps = true;
+        } else if (arg == "--fruit-life" && i + 1 < argc) {
+            config.settings.fruitLifetime = max(0, atoi(argv[++i]));
+        } else if (arg == "--hazards" && i + 1 < argc) {
+            config.settings.hazards = max(0, atoi(argv[++i]));
+        } else if (arg == "--portals" && i + 1 < argc) {
+            config.settings.portals = max(0, atoi(argv[++i]));
+        } else if (arg == "--no-obstacles") {
+            config.settings.enableObstacles = false;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            Tracer::instance().enable(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0] << " [--port N] [--workers N] [--players N] [--bots N] [--board WxH] [--fruits N] [--obstacles N] [--level STYLE] [--levels PACK] [--map FILE] [--power-ups] [--fruit-life N] [--hazards N] [--portals N] [--wrap] [--no-obstacles] [--seed N] [--trace FILE]" << endl;
+            return 1;
+        }
+    }
+    config.settings.snakes = min(MAX_SNAKES, config.settings.humans + bots);
+    if (map.isOpen()) {
+        config.settings.map = &map;
+        config.settings.width = map.getWidth();
+        config.settings.height = map.getHeight();
+        config.settings.wrapAround = map.wrapAround();
+        if (config.settings.snakes > map.startCount()) {
+            cerr << "The map has starts for " << map.startCount() << " snakes" << endl;
+            return 1;
+        }
+    }
+    if (!map.isOpen() && config.settings.snakes >= config.settings.height) {
+        cerr << "The board needs more rows than snakes" << endl;
+        return 1;
+    }
+    if (levels.isOpen() && !levels.fits(config.settings.width, config.settings.height, config.settings.snakes, config.settings.wrapAround)) {
+        cerr << "The level pack doesn't fit these rooms: it is for " << levels.getHeader().width << "x" << levels.getHeader().height
+             << (levels.getHeader().wrapAround ? " wrapping" : "") << " boards and up to " << (int)levels.getHeader().maxSnakes << " snakes" << endl;
+        return 1;
+    }
+    if (config.workers == 0) config.workers = max(1u, std::thread::hardware_concurrency());
+
+    raiseFileLimit();
+
+    // Signals arrive through a signalfd so shutdown happens on this thread
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int signalFd = signalfd(-1, &mask, SFD_CLOEXEC);
+
+    int listenFd = listenOn(config.port);
+    int statsFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    struct itimerspec second = {};
+    second.it_value.tv_sec = 1;
+    second.it_interval.tv_sec = 1;
+    timerfd_settime(statsFd, 0, &second, nullptr);
+
+    vector<Worker*> workers;
+    atomic<uint64_t> seatsDealt(0);
+    for (int i = 0; i < config.workers; i++) workers.push_back(new Worker(i, config, workers, seatsDealt));
+    for (Worker* w : workers) w->start();
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (int fd : { listenFd, signalFd, statsFd }) {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    cerr << "Listening on port " << config.port << " with " << config.workers << " workers, "
+         << config.settings.humans << " players + " << config.settings.snakes - config.settings.humans << " bots per room" << endl;
+
+    long long accepted = 0;
+    long long lastOpened = 0, lastTicks = 0, lastLate = 0, lastOverruns = 0, lastBytes = 0, lastFinished = 0, lastSkipped = 0;
+    bool running = true;
+    while (running) {
+        struct epoll_event events[8];
+        int n = epoll_wait(epollFd, events, 8, -1);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == signalFd) {
+                running = false;
+            } else if (fd == listenFd) {
+                while (true) {
+                    int client = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (client < 0) break;
+                    int one = 1;
+                    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    // Spread evenly; players are moved to their room's worker when they join
+                    workers[accepted % workers.size()]->hand(client);
+                    accepted++;
+                }
+            } else if (fd == statsFd) {
+                uint64_t expirations;
+                if (read(statsFd, &expirations, sizeof(expirations)) < 0) continue;
+                long long conns = 0, spectators = 0, skipped = 0, rooms = 0, opened = 0, finished = 0, ticks = 0, late = 0, lateMax = 0, overruns = 0, bytes = 0;
+                for (Worker* w : workers) {
+                    conns += w->stats.connections;
+                    spectators += w->stats.spectators;
+                    rooms += w->stats.rooms;
+                    opened += w->stats.roomsOpened;
+                    finished += w->stats.roomsFinished;
+                    ticks += w->stats.ticks;
+                    late += w->stats.lateTotal;
+                    lateMax = max(lateMax, w->stats.lateMax.exchange(0));
+                    overruns += w->stats.overruns;
+                    bytes += w->stats.bytesOut;
+                    skipped += w->stats.framesSkipped;
+                }
+                long long dTicks = ticks - lastTicks;
+                fprintf(stderr, "conns %lld (%lld watching) | rooms %lld | rooms/s opened %lld finished %lld | room ticks/s %lld"
+                                " | late avg %lldus max %lldus | overruns/s %lld | out %.1f KB/s | skipped frames/s %lld\n",
+                        conns, spectators, rooms, opened - lastOpened, finished - lastFinished, dTicks,
+                        dTicks ? (late - lastLate) / dTicks : 0, lateMax, overruns - lastOverruns,
+                        (bytes - lastBytes) / 1024.0, skipped - lastSkipped);
+                lastOpened = opened;
+                lastFinished = finished;
+                lastTicks = ticks;
+                lastLate = late;
+                lastOverruns = overruns;
+                lastBytes = bytes;
+                lastSkipped = skipped;
+            }
+        }
+    }
+
+    // All stopped before any is freed: a worker may still hand a spectator to another
+    for (Worker* w : workers) w->stop();
+    for (Worker* w : workers) delete w;
+    Tracer::instance().write();
+    close(listenFd);
+    close(statsFd);
+    close(signalFd);
+    close(epollFd);
+    return 0;
+}
@@ -0,0 +1,302 @@
+#ifndef TERMINAL_RENDERER_H
+#define TERMINAL_RENDERER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "snakeCore.h"
+
+// ANSI Color Codes
+#define COLOR_RESET   "\033[0m"
+#define COLOR_BLACK   "\033[30m"
+#define COLOR_RED     "\033[31m"
+#define COLOR_GREEN   "\033[32m"
+#define COLOR_YELLOW  "\033[33m"
+#define COLOR_BLUE    "\033[34m"
+#define COLOR_MAGENTA "\033[35m"
+#define COLOR_CYAN    "\033[36m"
+#define COLOR_WHITE   "\033[37m"
+#define COLOR_BOLD    "\033[1m"
+
+// Head/body colour per snake, cycled when there are more snakes than colours
+const char* const SNAKE_COLORS[] = { COLOR_YELLOW, COLOR_CYAN, COLOR_MAGENTA, COLOR_BLUE, COLOR_WHITE };
+const int SNAKE_COLOR_COUNT = sizeof(SNAKE_COLORS) / sizeof(SNAKE_COLORS[0]);
+
+// Fruit cell per FruitType, and the panel's name for each power-up's effect
+const char* const FRUIT_CELLS[] = {
+    COLOR_BOLD COLOR_RED "◆" COLOR_RESET, COLOR_BOLD COLOR_GREEN "◆" COLOR_RESET, COLOR_BOLD COLOR_WHITE "◇" COLOR_RESET,
+    COLOR_BOLD COLOR_YELLOW "★" COLOR_RESET, COLOR_BOLD COLOR_BLUE "◈" COLOR_RESET
+};
+const char* const EFFECT_NAMES[] = { "Ghost", "Double", "Slow-mo" };
+static_assert(sizeof(FRUIT_CELLS) / sizeof(FRUIT_CELLS[0]) == FRUIT_TYPE_COUNT &&
+              sizeof(EFFECT_NAMES) / sizeof(EFFECT_NAMES[0]) == EFFECT_COUNT, "a look for every fruit and effect");
+
+// What the info panel under the board shows
+struct PanelInfo {
+    bool started;       // false shows the welcome text instead
+    int elapsedSeconds;
+    int maxScore;
+    int focus;          // snake the camera follows, -1 = first human still alive
+    bool showPerf = false;      // adds the performance line
+    uint64_t ticks = 0;         // the event loop's tick counters, for that line
+    uint64_t droppedTicks = 0;
+};
+
+// Kept by the renderer about its own frames
+struct RenderStats {
+    uint64_t frames;
+    long long lastRenderNanos; // building and writing the previous frame
+    size_t lastFrameBytes;
+    uint64_t bytes;
+};
+
+// Draws a GameCore to the terminal. Shared by the local game and the network
+// client, which rebuilds a GameCore from what the server sends.
+class TerminalRenderer {
+public:
+    TerminalRenderer() : termCols(WIDTH + 2), termRows(HEIGHT + 7), fullRedraw(true), stats(), windowStart(0), windowTicks(0), ticksPerSecond(0) {
+        frame.reserve(8192);
+    }
+
+    // Queried once per resize rather than every frame
+    void updateTerminalSize() {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
+            termCols = ws.ws_col;
+            termRows = ws.ws_row;
+        }
+        fullRedraw = true;
+    }
+
+    // Clear the screen before the next frame (new round, panel changed height)
+    void requestFullRedraw() { fullRedraw = true; }
+
+    // Renders the part of the board that fits in the terminal. On boards larger
+    // than the screen the camera follows the head; off-screen cells are never
+    // visited. The frame is built in one reused buffer and written with a
+    // single flush.
+    void draw(const GameCore& core, const std::vector<std::string>& names, const PanelInfo& info) {
+        long long drawStart = nowNanos();
+        int width = core.getWidth(), height = core.getHeight();
+        const GameSettings& settings = core.getSettings();
+        bool wrapAround = settings.wrapAround;
+        bool multiplayer = settings.snakes > 1;
+        const std::vector<Snake>& snakes = core.getSnakes();
+        const FruitIndex& fruits = core.getFruits();
+
+        frame.clear();
+        if (fullRedraw) {
+            frame += "\033[2J";
+            fullRedraw = false;
+        }
+        frame += "\033[H";
+
+        int panelRows = info.started ? (multiplayer ? 2 : 1) + (info.showPerf ? 1 : 0) : 5;
+        int viewW = std::min(width, termCols - 2);
+        int viewH = std::min(height, termRows - 2 - panelRows);
+        if (viewW < 1 || viewH < 1) {
+            frame += COLOR_BOLD COLOR_RED "Terminal too small" COLOR_RESET "\033[K";
+            flushFrame(drawStart);
+            return;
+        }
+
+        // Camera centred on the head, clamped to the board
+        const Snake* focus = focusSnake(snakes, info.focus);
+        Cell head = focus ? focus->body.front() : Cell{ width / 2, height / 2 };
+        int camX = std::max(0, std::min(head.x - viewW / 2, width - viewW));
+        int camY = std::max(0, std::min(head.y - viewH / 2, height - viewH));
+
+        // Snake cells that fall inside the view, so each cell knows its owner
+        viewCells.assign((size_t)viewW * viewH, -1);
+        for (int i = 0; i < (int)snakes.size(); i++) {
+            bool first = true;
+            for (const Cell& c : snakes[i].body) {
+                if (c.x >= camX && c.x < camX + viewW && c.y >= camY && c.y < camY + viewH)
+                    viewCells[(size_t)(c.y - camY) * viewW + (c.x - camX)] = i * 2 + (first ? 1 : 0);
+                first = false;
+            }
+        }
+
+        // Real walls where the board edge is in view, a dotted frame where the
+        // board continues (cropped by the view, or wrapping around)
+        const char* leftEdge   = camX == 0 && !wrapAround ? "■" : "┆";
+        const char* rightEdge  = camX + viewW == width && !wrapAround ? "■" : "┆";
+        const char* topEdge    = camY == 0 && !wrapAround ? "■" : "┄";
+        const char* bottomEdge = camY + viewH == height && !wrapAround ? "■" : "┄";
+
+        frame += COLOR_BOLD COLOR_WHITE;
+        for (int i = 0; i < viewW + 2; i++) frame += topEdge;
+        frame += COLOR_RESET "\033[K\n";
+
+        for (int y = camY; y < camY + viewH; y++) {
+            frame += COLOR_BOLD COLOR_WHITE;
+            frame += leftEdge;
+            frame += COLOR_RESET;
+            const int* row = &viewCells[(size_t)(y - camY) * viewW];
+            for (int x = camX; x < camX + viewW; x++) {
+                int owner = row[x - camX];
+                if (owner >= 0 && (owner & 1)) {
+                    frame += COLOR_BOLD;
+                    frame += SNAKE_COLORS[(owner >> 1) % SNAKE_COLOR_COUNT];
+                    frame += "●" COLOR_RESET;
+                } else if (core.isHazard(x, y)) {
+                    frame += COLOR_BOLD COLOR_MAGENTA "✱" COLOR_RESET; // drawn over any fruit it passes
+                } else if (core.isFruit(x, y)) {
+                    frame += FRUIT_CELLS[fruits.find(x, y)->type];
+                } else if (core.isObstacle(x, y)) {
+                    frame += COLOR_BOLD COLOR_WHITE "▒" COLOR_RESET;
+                } else if (owner >= 0) {
+                    frame += COLOR_BOLD;
+                    frame += SNAKE_COLORS[(owner >> 1) % SNAKE_COLOR_COUNT];
+                    frame += "○" COLOR_RESET;
+                } else if (core.isPortal(x, y)) {
+                    frame += COLOR_BOLD COLOR_CYAN "◎" COLOR_RESET;
+                } else {
+                    frame += " ";
+                }
+            }
+            frame += COLOR_BOLD COLOR_WHITE;
+            frame += rightEdge;
+            frame += COLOR_RESET "\033[K\n";
+        }
+
+        frame += COLOR_BOLD COLOR_WHITE;
+        for (int i = 0; i < viewW + 2; i++) frame += bottomEdge;
+        frame += COLOR_RESET "\033[K\n";
+
+        // Game info panel (no trailing newline so a full-height frame never scrolls)
+        if (info.started) {
+            if (!multiplayer) {
+                appendf(COLOR_BOLD COLOR_BLUE " Player: " COLOR_RESET COLOR_CYAN "%s" COLOR_BOLD COLOR_BLUE " | Score: " COLOR_RESET COLOR_GREEN "%d",
+                        names[0].c_str(), snakes[0].score);
+            } else {
+                appendf(COLOR_BOLD COLOR_BLUE " Snakes: " COLOR_RESET COLOR_CYAN "%zu", snakes.size());
+            }
+            appendf(COLOR_BOLD COLOR_BLUE " | Time: " COLOR_RESET COLOR_CYAN "%ds" COLOR_BOLD COLOR_BLUE " | Max Score: " COLOR_RESET COLOR_YELLOW "%d" COLOR_RESET,
+                    info.elapsedSeconds, info.maxScore);
+            // The followed snake's running effects, with game seconds left
+            for (int e = 0; focus && e < EFFECT_COUNT; e++) {
+                if (!hasEffect(*focus, (Effect)e, core.getClock())) continue;
+                appendf(COLOR_BOLD COLOR_BLUE " | " COLOR_RESET COLOR_MAGENTA "%s %llds" COLOR_RESET, EFFECT_NAMES[e],
+                        (focus->effectEnds[e] - core.getClock() + 999999) / 1000000);
+            }
+            // When the board does not fit, point at the closest fruit off screen
+            Fruit closest;
+            if (focus && (viewW < width || viewH < height) && fruits.nearest(head.x, head.y, 1, &closest, wrapAround)) {
+                int dx = closest.x - head.x, dy = closest.y - head.y;
+                if (wrapAround) {
+                    // Going across the edge may be shorter
+                    if (2 * abs(dx) > width) dx -= dx > 0 ? width : -width;
+                    if (2 * abs(dy) > height) dy -= dy > 0 ? height : -height;
+                }
+                appendf(COLOR_BOLD COLOR_BLUE " | Nearest: " COLOR_RESET COLOR_RED "%d%s%s" COLOR_RESET, abs(dx) + abs(dy),
+                        dy < 0 ? "N" : dy > 0 ? "S" : "", dx < 0 ? "W" : dx > 0 ? "E" : "");
+            }
+            frame += "\033[K";
+            if (multiplayer) {
+                frame += "\n";
+                for (int i = 0; i < (int)snakes.size(); i++) {
+                    frame += COLOR_BOLD;
+                    frame += SNAKE_COLORS[i % SNAKE_COLOR_COUNT];
+                    appendf(" %s: " COLOR_RESET "%d%s", names[i].c_str(), snakes[i].score, snakes[i].alive ? "" : " ✗");
+                }
+                frame += "\033[K";
+            }
+            if (info.showPerf) appendPerf(info, focus, drawStart);
+        } else {
+            frame += COLOR_BOLD COLOR_GREEN "\033[K\n  WELCOME TO SNAKE GAME!\033[K\n" COLOR_RESET;
+            if (settings.humans > 1) {
+                appendf(COLOR_BOLD "  %s: " COLOR_GREEN "W/A/S/D" COLOR_RESET COLOR_BOLD ", %s: " COLOR_GREEN "I/J/K/L" COLOR_RESET COLOR_BOLD " to move\033[K\n",
+                        names[0].c_str(), names[1].c_str());
+            } else {
+                frame += COLOR_BOLD "  Use " COLOR_GREEN "W/A/S/D" COLOR_RESET COLOR_BOLD " to move\033[K\n";
+            }
+            frame += "  " COLOR_RED "X" COLOR_RESET COLOR_BOLD " to quit | " COLOR_MAGENTA "▒" COLOR_RESET COLOR_BOLD " are obstacles\033[K\n"
+                     "  Collect " COLOR_RED "◆" COLOR_RESET COLOR_BOLD " to grow!" COLOR_RESET "\033[K";
+        }
+        flushFrame(drawStart);
+    }
+
+    const RenderStats& getStats() const { return stats; }
+
+private:
+    int termCols, termRows;      // cached terminal size, refreshed on SIGWINCH
+    bool fullRedraw;             // clear the screen before the next frame
+    std::vector<int> viewCells;  // per visible cell: -1 empty, else snake*2 (+1 for a head)
+    std::string frame;           // reused, so a steady frame size means no allocation
+    RenderStats stats;
+    long long windowStart;       // ticks/s is recomputed about once a second
+    uint64_t windowTicks;
+    double ticksPerSecond;
+
+    static long long nowNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void flushFrame(long long drawStart) {
+        std::cout << frame << std::flush;
+        stats.frames++;
+        stats.lastFrameBytes = frame.size();
+        stats.bytes += frame.size();
+        stats.lastRenderNanos = nowNanos() - drawStart;
+    }
+
+    // printf onto the frame through a stack buffer, so the panel allocates
+    // nothing while the frame fits the buffer's capacity
+    __attribute__((format(printf, 2, 3))) void appendf(const char* format, ...) {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        if (n < 0) return;
+        if ((size_t)n < sizeof(line)) {
+            frame.append(line, n);
+            return;
+        }
+        // A long name: format straight into the frame instead
+        size_t at = frame.size();
+        frame.resize(at + n + 1);
+        va_start(args, format);
+        vsnprintf(&frame[at], n + 1, format, args);
+        va_end(args);
+        frame.resize(at + n);
+    }
+
+    // One line from the loop's TickStats and this renderer's RenderStats
+    void appendPerf(const PanelInfo& info, const Snake* focus, long long now) {
+        if (now - windowStart >= 1000000000LL) {
+            if (windowStart) ticksPerSecond = (info.ticks - windowTicks) * 1e9 / (now - windowStart);
+            windowStart = now;
+            windowTicks = info.ticks;
+        }
+        int speed = focus ? focus->speed : START_SPEED;
+        appendf("\n" COLOR_BOLD COLOR_MAGENTA " ticks/s " COLOR_RESET "%.1f" COLOR_BOLD COLOR_MAGENTA " | period " COLOR_RESET "%d/%dms"
+                COLOR_BOLD COLOR_MAGENTA " | render " COLOR_RESET "%.2fms" COLOR_BOLD COLOR_MAGENTA " | frame " COLOR_RESET "%zuB"
+                COLOR_BOLD COLOR_MAGENTA " | dropped " COLOR_RESET "%llu\033[K",
+                ticksPerSecond, speed / 1000, speed * 3 / 2000, stats.lastRenderNanos / 1e6, stats.lastFrameBytes,
+                (unsigned long long)info.droppedTicks);
+    }
+
+    // The camera follows the requested snake, else the first human still alive, else any snake
+    static const Snake* focusSnake(const std::vector<Snake>& snakes, int focus) {
+        if (focus >= 0 && focus < (int)snakes.size() && snakes[focus].alive) return &snakes[focus];
+        const Snake* any = nullptr;
+        for (const Snake& s : snakes) {
+            if (!s.alive) continue;
+            if (!s.bot) return &s;
+            if (!any) any = &s;
+        }
+        return any;
+    }
+};
+
+#endif
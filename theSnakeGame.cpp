@@ -1,387 +1,393 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
 #include <ctime>
-#include <unistd.h>
-#include <termios.h>
-#include <fcntl.h>
+#include <string>
 #include <vector>
 #include <chrono>
+#include "snakeCore.h"
+#include "eventLoop.h"
+#include "terminalRenderer.h"
+#include "leaderboard.h"
+#include "gameSave.h"
+#include "autoplay.h"
 
 using namespace std;
 
-// ANSI Color Codes
-#define COLOR_RESET   "\033[0m"
-#define COLOR_BLACK   "\033[30m"
-#define COLOR_RED     "\033[31m"
-#define COLOR_GREEN   "\033[32m"
-#define COLOR_YELLOW  "\033[33m"
-#define COLOR_BLUE    "\033[34m"
-#define COLOR_MAGENTA "\033[35m"
-#define COLOR_CYAN    "\033[36m"
-#define COLOR_WHITE   "\033[37m"
-#define COLOR_BOLD    "\033[1m"
-
-// Game dimensions
-const int WIDTH = 60;
-const int HEIGHT = 30;
-
-enum Direction { STOP = 0, UP, DOWN, LEFT, RIGHT };
-
-int kbhit() {
-    struct termios oldt, newt;
-    int ch;
-    int oldf;
-    
-    tcgetattr(STDIN_FILENO, &oldt);
-    newt = oldt;
-    newt.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-    oldf = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, oldf | O_NONBLOCK);
-    
-    ch = getchar();
-    
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-    fcntl(STDIN_FILENO, F_SETFL, oldf);
-    
-    if (ch != EOF) {
-        ungetc(ch, stdin);
-        return 1;
-    }
-    return 0;
-}
-
-struct Node {
-    int x, y;
-    Node* next;
-    Node(int x, int y) : x(x), y(y), next(nullptr) {}
-};
-
-enum FruitType { NORMAL, SLOW };
-
-struct Fruit {
-    int x, y;
-    FruitType type;
-};
-
+// Terminal front end: prompts, keyboard mapping and rendering around a GameCore
 class SnakeGame {
 private:
+    GameSettings settings;
+    GameCore core;
     bool gameOver;
     bool gameStarted;
     bool paused;
-    Node* head;
-    Node* tail;
-    vector<Fruit> fruits;
-    Direction dir;
-    int score;
-    int speed;
-    vector<pair<int, int>> obstacles;
+    bool quitting;          // X mid-game: save and leave
+    bool showPerf;          // O toggles the performance line
+    const TickStats* tickStats;
     chrono::steady_clock::time_point startTime;
-    int maxScore;
-    string playerName;
-    bool enableObstacles;
-
-    void spawnFruit() {
-        Fruit newFruit;
-        int attempts = 0;
-        while (attempts < 100) {
-            newFruit.x = rand() % WIDTH;
-            newFruit.y = rand() % HEIGHT;
-            if (!isObstacle(newFruit.x, newFruit.y) && !isSnakeBody(newFruit.x, newFruit.y)) {
-                int chance = rand() % 100;
-                newFruit.type = (chance < 15) ? SLOW : NORMAL; // 20% green, 80% red
-                fruits.push_back(newFruit);
-                return;
-            }
-            attempts++;
-        }
-        newFruit.x = WIDTH / 2;
-        newFruit.y = HEIGHT / 2;
-        newFruit.type = NORMAL;
-        fruits.push_back(newFruit);
+    int maxScore;           // player one's best on these settings, from the store
+    ScoreStore scores;
+    string leaderboardSocket;
+    Leaderboard localBoard; // stands in for the daemon when none is running
+    bool localLoaded;
+    string savePath;
+    vector<string> names;   // one per snake; bots get "Bot N"
+    TerminalRenderer renderer;
+
+    bool multiplayer() const { return settings.snakes > 1; }
+
+    void startIfNeeded() {
+        if (gameStarted) return;
+        gameStarted = true;
+        renderer.requestFullRedraw();
+        startTime = chrono::steady_clock::now();
+        core.start();
     }
 
-    void spawnObstacles() {
-        if (!enableObstacles) return; // Skip if obstacles are disabled
-        obstacles.clear();
-        int numObstacles = 8 + rand() % 25;
-        for (int i = 0; i < numObstacles; i++) {
-            int x, y;
-            do {
-                x = rand() % WIDTH;
-                y = rand() % HEIGHT;
-            } while (isSnakeBody(x, y) || isFruit(x, y));
-            obstacles.push_back({x, y});
-        }
+public:
+    SnakeGame(const GameSettings& settings, const string& scoresPath, const string& leaderboardSocket, const string& savePath)
+        : settings(settings), core(settings), gameOver(false), gameStarted(false), paused(false), quitting(false),
+          showPerf(false), tickStats(nullptr),
+          maxScore(0), scores(scoresPath), leaderboardSocket(leaderboardSocket), localLoaded(false), savePath(savePath) {
     }
 
-    bool isObstacle(int x, int y) {
-        if (!enableObstacles) return false; // No obstacles if disabled
-        for (auto& obs : obstacles) {
-            if (obs.first == x && obs.second == y) return true;
+    // Leaves the round in progress in the save file for the next run
+    void saveGame() {
+        SaveExtras extras;
+        extras.names = names;
+        extras.elapsedMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count();
+        extras.maxScore = maxScore;
+        if (writeSaveFile(savePath, core, extras)) {
+            cout << "\033[H\033[J" COLOR_BOLD "  Game saved. Run the game again to resume.\n" COLOR_RESET << flush;
         }
-        return false;
     }
 
-    bool isSnakeBody(int x, int y) {
-        for (Node* temp = head; temp; temp = temp->next) {
-            if (temp->x == x && temp->y == y) return true;
-        }
-        return false;
+    // Offers the saved round, if there is one. The save is used up either
+    // way, so a finished or declined game isn't offered again.
+    bool offerResume() {
+        GameCore saved;
+        SaveExtras extras;
+        if (!readSaveFile(savePath, saved, &extras)) return false;
+        unlink(savePath.c_str());
+        char choice;
+        cout << COLOR_BOLD COLOR_GREEN "Resume your saved game? (y/n): " COLOR_RESET;
+        cin >> choice;
+        if (choice != 'y' && choice != 'Y') return false;
+
+        saved.setLevelSources(settings.levels, settings.map);
+        settings = saved.getSettings();
+        core = std::move(saved);
+        names = extras.names;
+        for (int i = names.size(); i < settings.snakes; i++) names.push_back("Bot " + to_string(i + 1));
+        maxScore = extras.maxScore;
+        gameOver = false;
+        gameStarted = core.isStarted();
+        paused = gameStarted; // P carries on
+        startTime = chrono::steady_clock::now() - chrono::microseconds(extras.elapsedMicros);
+        renderer.requestFullRedraw();
+        return true;
     }
 
-    bool isFruit(int x, int y) {
-        for (auto& fruit : fruits) {
-            if (fruit.x == x && fruit.y == y) return true;
+    // Submits each human's score to the host's leaderboard daemon, or to
+    // this process's own board built from the local scores; returns player
+    // one's standings
+    Standings submitScores() {
+        Standings first;
+        for (int i = 0; i < settings.humans; i++) {
+            ScoreKey key = makeScoreKey(names[i], settings);
+            int score = core.getSnakes()[i].score;
+            Standings s;
+            if (!askLeaderboard(leaderboardSocket, key, score, s)) {
+                if (!localLoaded) {
+                    localBoard.load(scores);
+                    localLoaded = true;
+                }
+                s = localBoard.standings(key, score);
+            }
+            if (i == 0) first = s;
         }
-        return false;
+        return first;
     }
 
-    void clearSnake() {
-        while (head) {
-            Node* temp = head;
-            head = head->next;
-            delete temp;
+    void printStandings(const Standings& s) {
+        cout << COLOR_BOLD "  Top " << s.top.size() << " on " << settings.width << "x" << settings.height
+             << (settings.enableObstacles ? " with obstacles" : "") << (settings.wrapAround ? ", wrapping" : "")
+             << (settings.powerUps ? ", power-ups" : "") << ":" COLOR_RESET "\n";
+        for (size_t i = 0; i < s.top.size(); i++) {
+            string name = leaderName(s.top[i].name);
+            cout << "  " << (i < 9 ? " " : "") << i + 1 << ". " << (name == names[0] ? COLOR_YELLOW : "") << name
+                 << COLOR_RESET "  " << s.top[i].score << "\n";
         }
-        tail = nullptr;
-    }
-
-public:
-    SnakeGame() : maxScore(0), head(nullptr), tail(nullptr), enableObstacles(true) {
-        resetGame();
-    }
-
-    ~SnakeGame() {
-        clearSnake();
+        if (s.rank > 0) cout << COLOR_BOLD "  " << names[0] << " is #" << s.rank << " of " << s.players << COLOR_RESET "\n";
+        cout << "\n";
     }
 
     void resetGame() {
         gameOver = false;
         gameStarted = false;
         paused = false;
-        dir = STOP;
-        score = 0;
-        speed = 120000; // Increased speed by 1.25X (original: 150000)
-
-        clearSnake();
+        renderer.requestFullRedraw();
+        core.reset(((uint64_t)rand() << 31) ^ rand());
+    }
 
-        head = new Node(WIDTH / 2, HEIGHT / 2);
-        tail = head;
-        tail->next = new Node(head->x - 1, head->y);
-        tail = tail->next;
-        tail->next = new Node(head->x - 2, head->y);
-        tail = tail->next;
+    void draw() {
+        TRACE_SPAN("draw");
+        PanelInfo info;
+        info.started = gameStarted;
+        info.elapsedSeconds = gameStarted ? chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - startTime).count() : 0;
+        info.maxScore = maxScore;
+        info.focus = -1;
+        info.showPerf = showPerf;
+        if (tickStats) {
+            info.ticks = tickStats->ticks;
+            info.droppedTicks = tickStats->dropped;
+        }
+        renderer.draw(core, names, info);
+    }
 
-        fruits.clear();
-        for (int i = 0; i < (rand() % 7) + 2; i++) { // Initial 3 fruits
-            spawnFruit();
+    // Player one steers with W/A/S/D, player two with I/J/K/L
+    void input(char key) {
+        TRACE_SPAN("input");
+        int who = 0;
+        Direction d = STOP;
+        switch (key) {
+            case 'w': case 'W': d = UP; break;
+            case 's': case 'S': d = DOWN; break;
+            case 'a': case 'A': d = LEFT; break;
+            case 'd': case 'D': d = RIGHT; break;
+            case 'i': case 'I': who = 1; d = UP; break;
+            case 'k': case 'K': who = 1; d = DOWN; break;
+            case 'j': case 'J': who = 1; d = LEFT; break;
+            case 'l': case 'L': who = 1; d = RIGHT; break;
+            case 'p': case 'P': paused = !paused; break;
+            case 'o': case 'O':
+                showPerf = !showPerf;
+                renderer.requestFullRedraw();
+                break;
+            case 'x': case 'X':
+                if (gameStarted) {
+                    quitting = true;
+                } else {
+                    gameOver = true;
+                }
+                break;
         }
-        spawnObstacles();
+        if (d == STOP || who >= settings.humans) return;
+        startIfNeeded();
+        core.steer(who, d);
     }
 
-    void draw() {
-        cout << "\033[H";
+    void run() {
+        bool resumed = offerResume();
+        if (!resumed) choose();
+        maxScore = max(maxScore, scores.best(names[0], settings));
 
-        cout << COLOR_BOLD COLOR_WHITE;
-        for (int i = 0; i < WIDTH + 2; i++) cout << "■";
-        cout << COLOR_RESET << endl;
+        EventLoop loop;
+        char key;
+        renderer.updateTerminalSize();
+        tickStats = &loop.getTickStats();
 
-        for (int y = 0; y < HEIGHT; y++) {
-            for (int x = 0; x < WIDTH + 2; x++) {
-                if (x == 0 || x == WIDTH + 1) {
-                    cout << COLOR_BOLD COLOR_WHITE << "■" COLOR_RESET;
-                } else if (x == head->x && y == head->y) {
-                    cout << COLOR_BOLD COLOR_YELLOW "●" COLOR_RESET;
-                } else if (isFruit(x, y)) {
-                    for (auto& fruit : fruits) {
-                        if (fruit.x == x && fruit.y == y) {
-                            if (fruit.type == NORMAL)
-                                cout << COLOR_BOLD COLOR_RED "◆" COLOR_RESET;
-                            else
-                                cout << COLOR_BOLD COLOR_GREEN "◆" COLOR_RESET;
-                            break;
-                        }
-                    }
-                } else if (isObstacle(x, y)) {
-                    cout << COLOR_BOLD COLOR_WHITE "▒" COLOR_RESET;
-                } else {
-                    bool isBody = false;
-                    for (Node* temp = head->next; temp; temp = temp->next) {
-                        if (temp->x == x && temp->y == y) {
-                            cout << COLOR_BOLD COLOR_YELLOW "○" COLOR_RESET;
-                            isBody = true;
-                            break;
-                        }
+        while (true) {
+            if (!resumed) resetGame();
+            resumed = false;
+            draw();
+            long long armedFor = -1; // game clock the tick timer is set for
+            while (!gameOver) {
+                EventLoop::Event ev = loop.next(key);
+                // Leaving mid-round, by X or a signal, keeps the round for later
+                if (ev == EventLoop::QUIT) {
+                    if (gameStarted) saveGame();
+                    return;
+                }
+                if (ev == EventLoop::RESIZE) {
+                    renderer.updateTerminalSize();
+                } else if (ev == EventLoop::KEY) {
+                    input(key);
+                    if (quitting) {
+                        saveGame();
+                        return;
                     }
-                    if (!isBody) cout << " ";
+                } else if (ev == EventLoop::TICK && !paused) {
+                    TRACE_SPAN("logic");
+                    core.stepPhase();
+                    armedFor = -1;
+                }
+                if (core.isOver()) gameOver = true;
+
+                // Sleep until the next snake is due; nothing is armed while
+                // paused or before anyone moves
+                long long due = paused || gameOver ? -1 : core.nextMoveTime();
+                if (due != armedFor) {
+                    loop.armTimer(due < 0 ? 0 : max(1LL, due - core.getClock()));
+                    armedFor = due;
                 }
+                if (!gameOver) draw();
             }
-            cout << endl;
-        }
+            const vector<Snake>& snakes = core.getSnakes();
+            maxScore = max(maxScore, snakes[0].score);
+            vector<bool> newBest(snakes.size(), false);
+            for (int i = 0; i < settings.humans; i++) newBest[i] = scores.record(names[i], settings, snakes[i].score);
 
-        cout << COLOR_BOLD COLOR_WHITE;
-        for (int i = 0; i < WIDTH + 2; i++) cout << "■";
-        cout << COLOR_RESET << endl;
+            loop.flushInput();
 
-        // Game info panel
-        if (gameStarted) {
-            auto now = chrono::steady_clock::now();
-            int elapsedTime = chrono::duration_cast<chrono::seconds>(now - startTime).count();
-            cout << COLOR_BOLD COLOR_BLUE " Player: " COLOR_RESET << COLOR_CYAN << playerName
-                 << COLOR_BOLD COLOR_BLUE " | Score: " COLOR_RESET << COLOR_GREEN << score 
-                 << COLOR_BOLD COLOR_BLUE " | Time: " COLOR_RESET << COLOR_CYAN << elapsedTime << "s"
-                 << COLOR_BOLD COLOR_BLUE " | Max Score: " COLOR_RESET << COLOR_YELLOW << maxScore << COLOR_RESET << endl;
-        } else {
-            cout << COLOR_BOLD COLOR_GREEN "\n  WELCOME TO SNAKE GAME!\n" COLOR_RESET;
-            cout << COLOR_BOLD "  Use " COLOR_GREEN "W/A/S/D" COLOR_RESET COLOR_BOLD " to move\n"
-                 << "  " COLOR_RED "X" COLOR_RESET COLOR_BOLD " to quit | " COLOR_MAGENTA "▒" COLOR_RESET COLOR_BOLD " are obstacles\n"
-                 << "  Collect " COLOR_RED "◆" COLOR_RESET COLOR_BOLD " to grow!" COLOR_RESET << endl;
-        }
-    }
+            cout << "\033[H\033[J";
+            cout << COLOR_BOLD COLOR_RED "\n  GAME OVER!\n\n" COLOR_RESET;
+            if (!multiplayer()) {
+                cout << COLOR_BOLD "  Final Score: " COLOR_GREEN << snakes[0].score << COLOR_RESET
+                     << (newBest[0] ? COLOR_YELLOW " (new best!)" COLOR_RESET : "") << "\n";
+            } else {
+                for (int i = 0; i < (int)snakes.size(); i++) {
+                    cout << COLOR_BOLD << SNAKE_COLORS[i % SNAKE_COLOR_COUNT] << "  " << names[i] << ": " COLOR_RESET
+                         << COLOR_GREEN << snakes[i].score << COLOR_RESET << (snakes[i].alive ? "" : " ✗")
+                         << (newBest[i] ? COLOR_YELLOW " (new best!)" COLOR_RESET : "") << "\n";
+                }
+            }
+            cout << COLOR_BOLD "  Max Score: " COLOR_YELLOW << maxScore << COLOR_RESET "\n\n";
+            printStandings(submitScores());
+            cout << COLOR_BOLD "  Press " COLOR_GREEN "R" COLOR_RESET COLOR_BOLD " to restart\n"
+                 << "  Press " COLOR_RED "X" COLOR_RESET COLOR_BOLD " to exit\n" COLOR_RESET << flush;
 
-    void input() {
-        if (kbhit()) {
-            char key = getchar();
-            switch (key) {
-                case 'w': case 'W': 
-                    if (!gameStarted) {
-                        gameStarted = true;
-                        startTime = chrono::steady_clock::now();
-                    }
-                    if (dir != DOWN) dir = UP; 
-                    break;
-                case 's': case 'S': 
-                    if (!gameStarted) {
-                        gameStarted = true;
-                        startTime = chrono::steady_clock::now();
-                    }
-                    if (dir != UP) dir = DOWN; 
-                    break;
-                case 'a': case 'A': 
-                    if (!gameStarted) {
-                        gameStarted = true;
-                        startTime = chrono::steady_clock::now();
-                    }
-                    if (dir != RIGHT) dir = LEFT; 
-                    break;
-                case 'd': case 'D': 
-                    if (!gameStarted) {
-                        gameStarted = true;
-                        startTime = chrono::steady_clock::now();
-                    }
-                    if (dir != LEFT) dir = RIGHT; 
+            // Blocks in epoll_wait with the tick timer disarmed until a key arrives
+            while (true) {
+                EventLoop::Event ev = loop.next(key);
+                if (ev == EventLoop::QUIT) return;
+                if (ev != EventLoop::KEY) continue;
+                if (key == 'r' || key == 'R') {
                     break;
-                case 'p': case 'P': paused = !paused; break;
-                case 'x': case 'X': gameOver = true; break;
+                } else if (key == 'x' || key == 'X') {
+                    return;
+                }
             }
         }
     }
 
-    void logic() {
-        if (dir == STOP || paused) return;
-
-        int newX = head->x, newY = head->y;
-        if (dir == UP) newY--;
-        else if (dir == DOWN) newY++;
-        else if (dir == LEFT) newX--;
-        else if (dir == RIGHT) newX++;
-
-        if (newX < 0 || newX >= WIDTH || newY < 0 || newY >= HEIGHT || isObstacle(newX, newY)) {
-            gameOver = true;
-            return;
+    // Prompts for the players and the board for a new game
+    void choose() {
+        names.assign(1, "");
+        cout << COLOR_BOLD COLOR_GREEN "Enter your name: " COLOR_RESET;
+        cin >> names[0];
+
+        // A map decides its own walls and edges
+        if (!settings.map) {
+            char obstacleChoice;
+            cout << COLOR_BOLD COLOR_GREEN "Do you want obstacles? (y/n): " COLOR_RESET;
+            cin >> obstacleChoice;
+            settings.enableObstacles = (obstacleChoice == 'y' || obstacleChoice == 'Y');
+
+            char wrapChoice;
+            cout << COLOR_BOLD COLOR_GREEN "Wrap around the edges? (y/n): " COLOR_RESET;
+            cin >> wrapChoice;
+            settings.wrapAround = (wrapChoice == 'y' || wrapChoice == 'Y');
         }
 
-        for (Node* temp = head->next; temp; temp = temp->next) {
-            if (temp->x == newX && temp->y == newY) {
-                gameOver = true;
-                return;
-            }
+        // Snakes start on separate rows, so a short board limits how many fit;
+        // on a map, so does its number of starts
+        int maxSnakes = max(1, min(MAX_SNAKES, settings.height - 1));
+        if (settings.map) maxSnakes = max(1, min(maxSnakes, settings.map->startCount()));
+        settings.snakes = 1;
+        settings.humans = 1;
+        if (maxSnakes > 1) {
+            cout << COLOR_BOLD COLOR_GREEN "How many snakes? (1-" << maxSnakes << "): " COLOR_RESET;
+            cin >> settings.snakes;
+            settings.snakes = max(1, min(maxSnakes, settings.snakes));
         }
-
-        Node* newHead = new Node(newX, newY);
-        newHead->next = head;
-        head = newHead;
-
-        bool ateFruit = false;
-        for (auto it = fruits.begin(); it != fruits.end(); ) {
-            if (it->x == newX && it->y == newY) {
-                if (it->type == NORMAL) {
-                    score += 10;
-                    speed = max(45000, speed - 15000);
-                } else {
-                    score += 5;
-                    speed = min(300000, speed + 10000);
-                }
-                ateFruit = true;
-                it = fruits.erase(it);
-            } else {
-                ++it;
+        if (settings.snakes > 1) {
+            char humanChoice;
+            cout << COLOR_BOLD COLOR_GREEN "Is there a second player? (y/n): " COLOR_RESET;
+            cin >> humanChoice;
+            if (humanChoice == 'y' || humanChoice == 'Y') {
+                settings.humans = 2;
+                names.push_back("");
+                cout << COLOR_BOLD COLOR_GREEN "Enter player two's name: " COLOR_RESET;
+                cin >> names[1];
             }
         }
-
-        if (ateFruit) {
-            spawnFruit();
-        } else {
-            Node* temp = head;
-            while (temp->next->next) temp = temp->next;
-            delete temp->next;
-            temp->next = nullptr;
-            tail = temp;
+        for (int i = names.size(); i < settings.snakes; i++) {
+            names.push_back("Bot " + to_string(i + 1));
         }
+        core = GameCore(settings);
     }
+};
 
-    void run() {
-        cout << COLOR_BOLD COLOR_GREEN "Enter your name: " COLOR_RESET;
-        cin >> playerName;
-
-        char obstacleChoice;
-        cout << COLOR_BOLD COLOR_GREEN "Do you want obstacles? (y/n): " COLOR_RESET;
-        cin >> obstacleChoice;
-        enableObstacles = (obstacleChoice == 'y' || obstacleChoice == 'Y');
-
-        while (true) {
-            resetGame();
-            while (!gameOver) {
-                draw();
-                input();
-                if (!paused) {
-                    logic();
-                }
-                int adjusted_speed = speed;
-                if (dir == UP || dir == DOWN) {
-                    adjusted_speed = (speed*3)/2;
-                }
-                usleep(adjusted_speed);
+// Usage: theSnakeGame [--board WxH] [--fruits N] [--obstacles N] [--level STYLE] [--levels PACK] [--map FILE] [--power-ups] [--fruit-life N] [--hazards N] [--portals N] [--scores PATH] [--leaderboard SOCKET] [--save PATH] [--trace FILE]
+//        theSnakeGame --autoplay    (headless bot games; the PGO training run)
+int main(int argc, char* argv[]) {
+    GameSettings settings;
+    const char* home = getenv("HOME");
+    string scoresPath = string(home ? home : ".") + "/.snakeScores";
+    string leaderboardSocket = LEADERBOARD_SOCKET;
+    string savePath = string(home ? home : ".") + "/.snakeSave";
+    LevelPack levels;
+    LevelMap map;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--board" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &settings.width, &settings.height) != 2 ||
+                settings.width < 5 || settings.height < 1 ||
+                settings.width > MAX_BOARD_SIDE || settings.height > MAX_BOARD_SIDE) {
+                cerr << "--board expects WxH between 5x1 and " << MAX_BOARD_SIDE << "x" << MAX_BOARD_SIDE << endl;
+                return 1;
             }
-            maxScore = max(maxScore, score);
-            
-            while (kbhit()) getchar();
-            
-            cout << "\033[H\033[J";
-            cout << COLOR_BOLD COLOR_RED "\n  GAME OVER!\n\n" COLOR_RESET
-                 << COLOR_BOLD "  Final Score: " COLOR_GREEN << score << COLOR_RESET "\n"
-                 << COLOR_BOLD "  Max Score: " COLOR_YELLOW << maxScore << COLOR_RESET "\n\n"
-                 << COLOR_BOLD "  Press " COLOR_GREEN "R" COLOR_RESET COLOR_BOLD " to restart\n"
-                 << "  Press " COLOR_RED "X" COLOR_RESET COLOR_BOLD " to exit\n" COLOR_RESET;
-            
-            while (true) {
-                if (kbhit()) {
-                    char choice = getchar();
-                    if (choice == 'r' || choice == 'R') {
-                        break;
-                    } else if (choice == 'x' || choice == 'X') {
-                        return;
-                    }
-                }
-                usleep(50000);
+        } else if (arg == "--fruits" && i + 1 < argc) {
+            settings.fruits = max(0, atoi(argv[++i]));
+        } else if (arg == "--obstacles" && i + 1 < argc) {
+            settings.obstacles = max(0, atoi(argv[++i]));
+        } else if (arg == "--level" && i + 1 < argc) {
+            if (!parseLevelStyle(argv[++i], settings.level)) {
+                cerr << "--level expects scatter, walls, rooms or maze" << endl;
+                return 1;
             }
+        } else if (arg == "--levels" && i + 1 < argc) {
+            if (!levels.open(argv[++i])) return 1;
+            settings.levels = &levels;
+        } else if (arg == "--map" && i + 1 < argc) {
+            if (!map.open(argv[++i])) return 1;
+        } else if (arg == "--power-ups") {
+            settings.powerUps = true;
+        } else if (arg == "--fruit-life" && i + 1 < argc) {
+            settings.fruitLifetime = max(0, atoi(argv[++i]));
+        } else if (arg == "--hazards" && i + 1 < argc) {
+            settings.hazards = max(0, atoi(argv[++i]));
+        } else if (arg == "--portals" && i + 1 < argc) {
+            settings.portals = max(0, atoi(argv[++i]));
+        } else if (arg == "--scores" && i + 1 < argc) {
+            scoresPath = argv[++i];
+        } else if (arg == "--leaderboard" && i + 1 < argc) {
+            leaderboardSocket = argv[++i];
+        } else if (arg == "--save" && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            Tracer::instance().enable(argv[++i]);
+        } else if (arg == "--autoplay") {
+            AutoplayResult r = runAutoplay(true);
+            printf("%lld games, %lld phases, %lld frames in %.2fs: %.0f phases/s (checksum %016llx)\n", r.games, r.phases, r.frames,
+                   r.seconds, r.phases / r.seconds, (unsigned long long)r.checksum);
+            return 0;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--board WxH] [--fruits N] [--obstacles N] [--level STYLE] [--levels PACK] [--map FILE] [--power-ups] [--fruit-life N] [--hazards N] [--portals N] [--scores PATH] [--leaderboard SOCKET] [--save PATH] [--trace FILE] | --autoplay" << endl;
+            return 1;
         }
     }
-};
 
-int main() {
+    // A map sets the board, whatever --board says
+    if (map.isOpen()) {
+        settings.map = &map;
+        settings.width = map.getWidth();
+        settings.height = map.getHeight();
+        settings.wrapAround = map.wrapAround();
+        settings.enableObstacles = true;
+    }
+    // Snake count and wrapping are chosen later; a game they don't fit generates its levels
+    if (levels.isOpen() && !levels.fits(settings.width, settings.height, 1, true)) {
+        cerr << "The level pack is for " << levels.getHeader().width << "x" << levels.getHeader().height << " boards; pass the matching --board" << endl;
+        return 1;
+    }
+
     srand(time(0));
-    SnakeGame game;
+    SnakeGame game(settings, scoresPath, leaderboardSocket, savePath);
     game.run();
+    Tracer::instance().write();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,178 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hashed timing wheel. Time is cut into slots of `resolution` microseconds
+// hashed onto a ring of buckets; an entry due more than one turn ahead waits
+// out the extra turns in its bucket. Scheduling is O(1) and advancing costs
+// one bucket visit per elapsed slot, however many timers are pending.
+// Entries can't be cancelled: owners tag them (e.g. with a generation) and
+// ignore stale ones when they fire.
+class TimerWheel {
+public:
+    TimerWheel(long long resolution, int slotCount)
+        : resolution(resolution), buckets(slotCount), current(0), pending(0) {}
+
+    // Starts the wheel at `now`; nothing fires for slots before it
+    void start(long long now) { current = now / resolution; }
+
+    void schedule(uint64_t id, long long due) {
+        long long slot = due / resolution;
+        if (slot < current) slot = current; // already late: fire on the next advance
+        Entry e = { id, due };
+        buckets[slot % buckets.size()].push_back(e);
+        pending++;
+    }
+
+    // Fires fire(id, due) for every entry due at or before `now`
+    template <class Fn>
+    void advance(long long now, Fn fire) {
+        long long last = now / resolution;
+        // After a long stall one full turn covers every bucket
+        if (last - current >= (long long)buckets.size()) current = last - buckets.size() + 1;
+        for (; current <= last; current++) {
+            std::vector<Entry>& bucket = buckets[current % buckets.size()];
+            for (size_t i = 0; i < bucket.size(); ) {
+                if (bucket[i].due / resolution <= last && bucket[i].due <= now) {
+                    Entry e = bucket[i];
+                    bucket[i] = bucket.back();
+                    bucket.pop_back();
+                    pending--;
+                    fire(e.id, e.due); // may schedule into this same bucket
+                } else {
+                    i++;
+                }
+            }
+        }
+        current = last; // the current slot may still hold entries due later in it
+    }
+
+    // Microseconds from `now` until the next slot boundary, or -1 when empty
+    long long timeout(long long now) const {
+        if (pending == 0) return -1;
+        return resolution - now % resolution;
+    }
+
+    size_t size() const { return pending; }
+
+private:
+    struct Entry {
+        uint64_t id;
+        long long due;
+    };
+
+    long long resolution;
+    std::vector<std::vector<Entry>> buckets;
+    long long current; // slot number of the oldest bucket not yet fully expired
+    size_t pending;
+};
+
+// Hierarchical timing wheel over integer ticks: WHEEL_LEVELS rings of
+// WHEEL_SLOTS slots, where one slot of a ring spans a whole turn of the ring
+// below. An entry is filed in the lowest ring whose current turn contains its
+// due tick; when the clock enters a slot of a higher ring, that slot's entries
+// are refiled one ring down. Scheduling is O(1), and a tick visits one bottom
+// slot plus a cascade every WHEEL_SLOTS ticks, however many timers are
+// pending. Entries due past the top ring's turn wait in an overflow list that
+// is refiled once per top turn. Like TimerWheel, entries can't be cancelled.
+class HierarchicalTimerWheel {
+public:
+    static const int WHEEL_LEVELS = 4;
+    static const int WHEEL_SLOT_BITS = 6;
+    static const int WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS;
+
+    HierarchicalTimerWheel() : now(0), pending(0) {}
+
+    // Drops every entry and sets the wheel's clock
+    void reset(long long tick) {
+        for (std::vector<Entry>& slot : slots) slot.clear();
+        overflow.clear();
+        late.clear();
+        now = tick;
+        pending = 0;
+    }
+
+    // Entries due now or earlier fire on the next advance
+    void schedule(uint64_t id, long long due) {
+        Entry e = { id, due };
+        if (due <= now) late.push_back(e);
+        else file(e);
+        pending++;
+    }
+
+    // Moves the clock to `tick`, calling fire(id, due) for every entry due at
+    // or before it; entries due on the same tick fire in no set order
+    template <class Fn>
+    void advance(long long tick, Fn fire) {
+        for (size_t i = 0; i < late.size(); i++) {
+            pending--;
+            fire(late[i].id, late[i].due);
+        }
+        late.clear();
+        if (pending == 0 && now < tick) now = tick; // nothing to visit on the way
+        while (now < tick) {
+            now++;
+            cascade();
+            std::vector<Entry>& slot = slots[now & (WHEEL_SLOTS - 1)];
+            for (size_t i = 0; i < slot.size(); i++) {
+                pending--;
+                fire(slot[i].id, slot[i].due);
+            }
+            slot.clear();
+            if (pending == 0) now = tick;
+        }
+    }
+
+    long long getTick() const { return now; }
+    size_t size() const { return pending; }
+
+private:
+    struct Entry {
+        uint64_t id;
+        long long due;
+    };
+
+    std::vector<Entry> slots[WHEEL_LEVELS * WHEEL_SLOTS];
+    std::vector<Entry> overflow; // due past the top ring's current turn
+    std::vector<Entry> late;     // due at or before the clock when scheduled
+    std::vector<Entry> spare;    // refile()'s scratch
+    long long now;
+    size_t pending;
+
+    // Ring `level` takes entries (due at or after the clock) that share every
+    // digit above its own with the clock; their slot is their digit there
+    void file(const Entry& e) {
+        for (int level = 0; level < WHEEL_LEVELS; level++) {
+            int shift = WHEEL_SLOT_BITS * (level + 1);
+            if ((e.due >> shift) == (now >> shift)) {
+                slots[level * WHEEL_SLOTS + ((e.due >> (shift - WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1))].push_back(e);
+                return;
+            }
+        }
+        overflow.push_back(e);
+    }
+
+    // Called as the clock reaches a new tick: every ring whose turn just
+    // ticked over hands its current slot down, top ring first
+    void cascade() {
+        int level = 1;
+        while (level < WHEEL_LEVELS && (now & ((1LL << (WHEEL_SLOT_BITS * level)) - 1)) == 0) level++;
+        if (level == WHEEL_LEVELS) refile(overflow);
+        for (level--; level >= 1; level--) {
+            refile(slots[level * WHEEL_SLOTS + ((now >> (WHEEL_SLOT_BITS * level)) & (WHEEL_SLOTS - 1))]);
+        }
+    }
+
+    // The overflow list may take some of its own entries back, so they are
+    // moved out first; the two vectors trade storage instead of allocating
+    void refile(std::vector<Entry>& from) {
+        spare.swap(from);
+        for (const Entry& e : spare) file(e);
+        spare.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Optional span tracing for profiling sessions, written out as a Chrome trace
+// (chrome://tracing, ui.perfetto.dev). Every thread records into its own ring
+// of TRACE_RING_SIZE spans: a span is two clock reads and one store, with no
+// locks and no allocation once the ring exists, and when the ring is full the
+// oldest spans are overwritten. With tracing off a span costs one branch.
+//
+//     TRACE_SPAN("draw");   // covers the rest of the enclosing scope
+//
+// The rings are read only by write(), after the threads that fill them have
+// stopped.
+
+const size_t TRACE_RING_SIZE = 1 << 16; // spans kept per thread
+
+struct TraceEvent {
+    const char* name;   // a string literal; only the pointer is stored
+    long long start;    // nanoseconds on the steady clock
+    long long duration;
+};
+
+struct TraceRing {
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head{0}; // spans ever recorded; the newest is at head - 1
+    int tid;
+    std::string threadName;
+};
+
+class Tracer {
+public:
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // Turns tracing on; call before starting the threads to trace
+    void enable(const std::string& path) {
+        outputPath = path;
+        origin = nowNanos();
+        on.store(true, std::memory_order_release);
+    }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    // Labels the calling thread's track in the trace viewer
+    void nameThread(const std::string& name) {
+        if (enabled()) ring()->threadName = name;
+    }
+
+    void record(const char* name, long long start, long long end) {
+        TraceRing* r = ring();
+        uint64_t h = r->head.load(std::memory_order_relaxed);
+        TraceEvent& e = r->events[h % TRACE_RING_SIZE];
+        e.name = name;
+        e.start = start;
+        e.duration = end - start;
+        r->head.store(h + 1, std::memory_order_release);
+    }
+
+    // Writes every ring as complete ("X") events, oldest first per thread
+    bool write() {
+        if (!enabled()) return true;
+        FILE* f = fopen(outputPath.c_str(), "w");
+        if (!f) {
+            perror(outputPath.c_str());
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(ringsLock);
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const std::unique_ptr<TraceRing>& r : rings) {
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", r->tid, r->threadName.c_str());
+            first = false;
+            uint64_t head = r->head.load(std::memory_order_acquire);
+            uint64_t begin = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+            for (uint64_t i = begin; i < head; i++) {
+                const TraceEvent& e = r->events[i % TRACE_RING_SIZE];
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        e.name, r->tid, (e.start - origin) / 1000.0, e.duration / 1000.0);
+            }
+        }
+        fprintf(f, "\n]}\n");
+        bool ok = fclose(f) == 0;
+        if (!ok) perror(outputPath.c_str());
+        return ok;
+    }
+
+    static long long nowNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::atomic<bool> on{false};
+    std::string outputPath;
+    long long origin = 0;
+    std::mutex ringsLock; // taken once per thread, when its ring is created
+    std::vector<std::unique_ptr<TraceRing>> rings;
+
+    TraceRing* ring() {
+        static thread_local TraceRing* mine = nullptr;
+        if (!mine) {
+            std::unique_ptr<TraceRing> r(new TraceRing());
+            r->events.resize(TRACE_RING_SIZE);
+            std::lock_guard<std::mutex> guard(ringsLock);
+            r->tid = rings.size() + 1;
+            r->threadName = r->tid == 1 ? "main" : "thread " + std::to_string(r->tid);
+            mine = r.get();
+            rings.push_back(std::move(r));
+        }
+        return mine;
+    }
+};
+
+// Records the enclosing scope as one span when tracing is on
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name(name), start(Tracer::instance().enabled() ? Tracer::nowNanos() : 0) {}
+    ~TraceSpan() {
+        if (start) Tracer::instance().record(name, start, Tracer::nowNanos());
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    long long start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif